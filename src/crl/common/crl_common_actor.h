@@ -0,0 +1,166 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/crl_queue.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace crl {
+
+// Contiguous range of messages, like std::span from C++20.
+template <typename Type>
+class span {
+public:
+	span() = default;
+	span(Type *data, std::size_t size) : _data(data), _size(size) {
+	}
+
+	[[nodiscard]] Type *data() const {
+		return _data;
+	}
+	[[nodiscard]] std::size_t size() const {
+		return _size;
+	}
+	[[nodiscard]] bool empty() const {
+		return !_size;
+	}
+	[[nodiscard]] Type &operator[](std::size_t index) const {
+		return _data[index];
+	}
+	[[nodiscard]] Type *begin() const {
+		return _data;
+	}
+	[[nodiscard]] Type *end() const {
+		return _data + _size;
+	}
+
+private:
+	Type *_data = nullptr;
+	std::size_t _size = 0;
+
+};
+
+namespace details {
+
+template <typename Type, typename Message>
+class actor_data final
+	: public std::enable_shared_from_this<actor_data<Type, Message>> {
+public:
+	template <typename ...Args>
+	explicit actor_data(Args &&...args)
+	: _value(std::forward<Args>(args)...) {
+	}
+
+	template <typename ...Args>
+	void emplace(Args &&...args) {
+		auto lock = std::unique_lock<std::mutex>(_mutex);
+		_incoming.emplace_back(std::forward<Args>(args)...);
+		if (_incoming.size() == 1) {
+			lock.unlock();
+			_queue.async([that = this->shared_from_this()] {
+				that->process();
+			});
+		}
+	}
+
+	template <typename Method>
+	void with(Method &&method) {
+		_queue.async([
+			that = this->shared_from_this(),
+			method = std::forward<Method>(method)
+		]() mutable {
+			std::move(method)(that->_value);
+		});
+	}
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+	void wait_idle() {
+		_queue.wait_idle();
+	}
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+
+private:
+	void process() {
+		{
+			const auto lock = std::lock_guard<std::mutex>(_mutex);
+			std::swap(_incoming, _processing);
+		}
+		_value.handle(span<Message>(_processing.data(), _processing.size()));
+
+		// Keep the capacity, so that steady traffic doesn't allocate.
+		_processing.clear();
+	}
+
+	Type _value;
+
+	std::mutex _mutex;
+	std::vector<Message> _incoming;
+
+	// Accessed only from the queue.
+	std::vector<Message> _processing;
+
+	crl::queue _queue;
+
+};
+
+} // namespace details
+
+// Owns an object that receives typed messages on its own queue.
+// The messages are stored by value in a mailbox, so sending doesn't
+// allocate once the mailbox has grown, and all the messages that came
+// while the object was busy are passed in one handle(span) call.
+// The queued tasks keep the object alive, like in object_on_queue,
+// so the actor may be destroyed with messages still pending.
+template <typename Type, typename Message>
+class actor {
+public:
+	template <typename ...Args>
+	explicit actor(Args &&...args)
+	: _data(std::make_shared<Data>(std::forward<Args>(args)...)) {
+	}
+	actor(const actor &other) = delete;
+	actor &operator=(const actor &other) = delete;
+
+	void send(Message &&message) {
+		_data->emplace(std::move(message));
+	}
+	void send(const Message &message) {
+		_data->emplace(message);
+	}
+
+	template <typename ...Args>
+	void emplace(Args &&...args) {
+		_data->emplace(std::forward<Args>(args)...);
+	}
+
+	// Runs on the actor queue after the messages sent before it.
+	template <typename Method>
+	void with(Method &&method) {
+		_data->with(std::forward<Method>(method));
+	}
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+	// Blocks until all the messages are handled.
+	void wait_idle() {
+		_data->wait_idle();
+	}
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+
+private:
+	using Data = details::actor_data<Type, Message>;
+
+	std::shared_ptr<Data> _data;
+
+};
+
+} // namespace crl
@@ -0,0 +1,75 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+
+#ifdef CRL_USE_COMMON_POOL
+
+#include <crl/common/crl_common_utils.h>
+#include <crl/common/crl_common_sync.h>
+#include <crl/common/crl_common_pool.h>
+#include <type_traits>
+
+namespace crl::details {
+
+void async_plain(void (*callable)(void*), void *argument);
+
+// Runs on the workers of the NUMA node, see crl::pool_nodes().
+void async_plain_on(int node, void (*callable)(void*), void *argument);
+
+// Runs on the blocking pool, see crl::configure_blocking_pool().
+void async_blocking_plain(void (*callable)(void*), void *argument);
+
+using async_plain_method = void(*)(void (*callable)(void*), void *argument);
+
+template <
+	typename Callable,
+	typename Return = decltype(std::declval<Callable>()())>
+inline void async_with(async_plain_method method, Callable &&callable) {
+	using Function = std::decay_t<Callable>;
+
+	if constexpr (details::is_plain_function_v<Function, Return>) {
+		using Plain = Return(*)();
+		const auto copy = static_cast<Plain>(callable);
+		method([](void *passed) {
+			const auto callable = reinterpret_cast<Plain>(passed);
+			(*callable)();
+		}, reinterpret_cast<void*>(copy));
+	} else {
+		const auto copy = new Function(std::forward<Callable>(callable));
+		method([](void *passed) {
+			const auto callable = static_cast<Function*>(passed);
+			const auto guard = details::finally([=] { delete callable; });
+			(*callable)();
+		}, static_cast<void*>(copy));
+	}
+}
+
+} // namespace crl::details
+
+namespace crl {
+
+template <typename Callable>
+inline void async(Callable &&callable) {
+	details::async_with(
+		details::async_plain,
+		std::forward<Callable>(callable));
+}
+
+// For tasks that wait in syscalls: file I/O, fsync, DNS and so on.
+template <typename Callable>
+inline void async_blocking(Callable &&callable) {
+	details::async_with(
+		details::async_blocking_plain,
+		std::forward<Callable>(callable));
+}
+
+} // namespace crl
+
+#endif // CRL_USE_COMMON_POOL
@@ -0,0 +1,61 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_barrier.h>
+
+namespace crl {
+
+barrier::barrier(int count) : _count(count), _remaining(count) {
+}
+
+auto barrier::arrive() -> phase {
+	// The phase can't change before we arrive, so it is read first.
+	const auto arrived = (_phase.load() & kPhaseMask);
+	if (_remaining.fetch_sub(1) != 1) {
+		return arrived;
+	}
+	_remaining.store(_count);
+	const auto was = _phase.exchange((arrived + 1) & kPhaseMask);
+	if (was & kWaiterBit) {
+		details::futex_wake_all(&_phase);
+	}
+	return arrived;
+}
+
+template <typename Wait>
+bool barrier::wait_with(phase arrived, Wait &&wait) {
+	auto value = _phase.load();
+	while (true) {
+		if ((value & kPhaseMask) != arrived) {
+			return true;
+		} else if (!(value & kWaiterBit)) {
+			if (!_phase.compare_exchange_weak(value, value | kWaiterBit)) {
+				continue;
+			}
+			value |= kWaiterBit;
+		}
+		if (!wait(value)) {
+			return try_wait(arrived);
+		}
+		value = _phase.load();
+	}
+}
+
+void barrier::wait(phase arrived) {
+	wait_with(arrived, [&](std::uint32_t value) {
+		details::futex_wait(&_phase, value);
+		return true;
+	});
+}
+
+bool barrier::wait_until(phase arrived, crl::time deadline) {
+	return wait_with(arrived, [&](std::uint32_t value) {
+		return details::futex_wait_for(&_phase, value, deadline - crl::now());
+	});
+}
+
+} // namespace crl
@@ -0,0 +1,52 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_futex.h>
+
+namespace crl {
+
+// Reusable rendezvous point for a fixed number of threads.
+class barrier {
+public:
+	using phase = std::uint32_t;
+
+	explicit barrier(int count);
+	barrier(const barrier &other) = delete;
+	barrier &operator=(const barrier &other) = delete;
+
+	// Returns the phase to wait for, the last arrival starts a new one.
+	phase arrive();
+
+	[[nodiscard]] bool try_wait(phase arrived) const {
+		return ((_phase.load() & kPhaseMask) != arrived);
+	}
+	void wait(phase arrived);
+
+	// Returns false if the deadline (in crl::now() terms) has passed.
+	bool wait_until(phase arrived, crl::time deadline);
+
+	void arrive_and_wait() {
+		wait(arrive());
+	}
+
+private:
+	static constexpr auto kWaiterBit = std::uint32_t(1) << 31;
+	static constexpr auto kPhaseMask = kWaiterBit - 1;
+
+	template <typename Wait>
+	bool wait_with(phase arrived, Wait &&wait);
+
+	const int _count = 0;
+	std::atomic<int> _remaining = 0;
+	details::futex_value _phase = 0;
+
+};
+
+} // namespace crl
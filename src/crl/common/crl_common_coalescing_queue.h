@@ -0,0 +1,121 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/crl_queue.h>
+#include <crl/common/crl_common_list.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace crl {
+
+// Serial queue that keeps at most one pending task for each key.
+// Posting for a key that has a task pending replaces that task in place,
+// so the outdated updates are dropped and only the newest one runs.
+// Pending tasks run in the order their keys were first posted.
+//
+// Tasks may be move-only, each one is kept in a single list entry like
+// in crl::queue. The task lists and the key index nodes are reused, so
+// steady updates allocate only that entry.
+template <typename Key, typename Hash = std::hash<Key>>
+class coalescing_queue {
+public:
+	coalescing_queue() = default;
+	coalescing_queue(const coalescing_queue &other) = delete;
+	coalescing_queue &operator=(const coalescing_queue &other) = delete;
+
+	template <typename Callable>
+	void async(const Key &key, Callable &&callable) {
+		using Type = details::list_entry_with<
+			entry_data,
+			std::decay_t<Callable>>;
+		auto task = Task(details::allocate_list_entry<entry_data>(
+			std::forward<Callable>(callable)));
+		task->destroy = [](Entry *entry) {
+			delete static_cast<Type*>(entry);
+		};
+		auto lock = std::unique_lock<std::mutex>(_mutex);
+		const auto i = _index.find(key);
+		if (i != end(_index)) {
+			// Destroy the replaced task outside of the lock.
+			std::swap(_pending[i->second], task);
+			lock.unlock();
+			return;
+		}
+		if (_spare.empty()) {
+			_index.emplace(key, _pending.size());
+		} else {
+			auto node = std::move(_spare.back());
+			_spare.pop_back();
+			node.key() = key;
+			node.mapped() = _pending.size();
+			_index.insert(std::move(node));
+		}
+		_pending.push_back(std::move(task));
+		if (_pending.size() == 1) {
+			lock.unlock();
+			_queue.async([=] { process(); });
+		}
+	}
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+	// Blocks until all the pending tasks are processed.
+	void wait_idle() {
+		_queue.wait_idle();
+	}
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+
+private:
+	struct entry_data {
+		// Deletes a replaced task without invoking it.
+		void (*destroy)(details::list_entry<entry_data> *entry) = nullptr;
+	};
+	using Entry = details::list_entry<entry_data>;
+	struct entry_deleter {
+		void operator()(Entry *entry) const {
+			entry->destroy(entry);
+		}
+	};
+	using Task = std::unique_ptr<Entry, entry_deleter>;
+	using Index = std::unordered_map<Key, std::size_t, Hash>;
+
+	void process() {
+		{
+			const auto lock = std::lock_guard<std::mutex>(_mutex);
+			std::swap(_pending, _processing);
+			while (!_index.empty()) {
+				_spare.push_back(_index.extract(begin(_index)));
+			}
+		}
+		for (auto &task : _processing) {
+			// Invokes the task and deletes the entry.
+			const auto entry = task.release();
+			entry->process(entry);
+		}
+
+		// Keep the capacity, so that steady updates don't allocate.
+		_processing.clear();
+	}
+
+	std::mutex _mutex;
+	std::vector<Task> _pending;
+	Index _index;
+	std::vector<typename Index::node_type> _spare;
+
+	// Accessed only from the queue.
+	std::vector<Task> _processing;
+
+	crl::queue _queue;
+
+};
+
+} // namespace crl
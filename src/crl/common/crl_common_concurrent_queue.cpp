@@ -0,0 +1,105 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_concurrent_queue.h>
+
+#include <crl/crl_async.h>
+#include <algorithm>
+
+namespace crl {
+
+concurrent_queue::concurrent_queue(int max_parallelism)
+: _limit(std::max(max_parallelism, 1)) {
+}
+
+void concurrent_queue::push(BasicEntry *entry) {
+	auto head = _head.load();
+	do {
+		entry->next = head;
+	} while (!_head.compare_exchange_weak(head, entry));
+	++_waiting;
+	wake_async();
+}
+
+void concurrent_queue::wake_async() {
+	auto running = _running.load();
+	while (running < _limit) {
+		if (_running.compare_exchange_weak(running, running + 1)) {
+			// The drainer holds the queue busy until it is done with it.
+			_inflight.increment();
+			details::async_plain(ProcessCallback, static_cast<void*>(this));
+			return;
+		}
+	}
+}
+
+auto concurrent_queue::take() -> BasicEntry* {
+	while (true) {
+		auto expected = false;
+		if (_queued.compare_exchange_strong(expected, true)) {
+			if (!_pending) {
+				if (auto entry = _head.exchange(nullptr)) {
+					if (const auto next = entry->next) {
+						entry = details::reverse_list(entry, next);
+					}
+					_pending = entry;
+				}
+			}
+			const auto result = _pending;
+			if (result) {
+				_pending = result->next;
+				--_waiting;
+			}
+			_queued.store(false);
+			if (result) {
+				// Wake one more drainer, up to the parallelism limit.
+				if (_waiting.load() > 0) {
+					wake_async();
+				}
+				return result;
+			}
+		}
+		_running.fetch_sub(1);
+
+		// If another drainer is taking an entry right now it will wake
+		// us up when it is done. Otherwise the entries pushed while we
+		// were giving up the slot are ours to take.
+		if (!_waiting.load() || _queued.load()) {
+			return nullptr;
+		}
+		auto running = _running.load();
+		do {
+			if (running >= _limit) {
+				return nullptr;
+			}
+		} while (!_running.compare_exchange_weak(running, running + 1));
+	}
+}
+
+void concurrent_queue::process() {
+	while (const auto entry = take()) {
+		entry->process(entry);
+		_inflight.decrement();
+	}
+
+	// The queue may be destroyed right after that.
+	_inflight.decrement();
+}
+
+void concurrent_queue::ProcessCallback(void *that) {
+	static_cast<concurrent_queue*>(that)->process();
+}
+
+void concurrent_queue::wait_idle() {
+	_inflight.wait();
+}
+
+bool concurrent_queue::flush(crl::time deadline) {
+	return _inflight.wait_until(deadline);
+}
+
+} // namespace crl
@@ -0,0 +1,75 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_list.h>
+#include <crl/common/crl_common_utils.h>
+#include <crl/common/crl_common_inflight_counter.h>
+#include <crl/common/crl_common_sync_wait.h>
+#include <atomic>
+
+namespace crl {
+
+// Runs up to max_parallelism tasks at once, starting them in order.
+class concurrent_queue {
+public:
+	explicit concurrent_queue(int max_parallelism);
+	concurrent_queue(const concurrent_queue &other) = delete;
+	concurrent_queue &operator=(const concurrent_queue &other) = delete;
+
+	template <typename Callable>
+	void async(Callable &&callable) {
+		_inflight.increment();
+		push(details::allocate_list_entry(std::forward<Callable>(callable)));
+	}
+
+	template <typename Callable>
+	void sync(Callable &&callable) {
+		semaphore waiter;
+		async([&] {
+			const auto guard = details::finally([&] { waiter.release(); });
+			callable();
+		});
+		details::sync_wait(waiter);
+	}
+
+	[[nodiscard]] int max_parallelism() const {
+		return _limit;
+	}
+
+	void wait_idle();
+	bool flush(crl::time deadline);
+
+private:
+	using BasicEntry = details::list_entry<>;
+
+	static void ProcessCallback(void *that);
+
+	void push(BasicEntry *entry);
+	void wake_async();
+	void process();
+	BasicEntry *take();
+
+	const int _limit = 1;
+
+	// Lock-free intake, drainers move it to the pending list in order.
+	std::atomic<BasicEntry*> _head = nullptr;
+	std::atomic<int> _waiting = 0;
+	std::atomic<int> _running = 0;
+
+	// One drainer at a time takes the pending entries, the others
+	// don't wait for it, it wakes them up if more entries are left.
+	std::atomic<bool> _queued = false;
+	BasicEntry *_pending = nullptr;
+
+	details::inflight_counter _inflight;
+
+};
+
+} // namespace crl
@@ -15,6 +15,21 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #define CRL_USE_LINUX_TIME
 #endif // !_MSC_VER && !__APPLE__
 
+#if defined __linux__
+#define CRL_USE_LINUX_FUTEX
+#define CRL_USE_LINUX_TOPOLOGY
+#define CRL_USE_LINUX_MAIN_LOOP
+#else // __linux__
+#define CRL_USE_COMMON_FUTEX
+#define CRL_USE_COMMON_TOPOLOGY
+#endif // !__linux__
+
+#if defined __linux__ && __has_include(<linux/io_uring.h>)
+#define CRL_USE_LINUX_IO
+#elif !defined _MSC_VER // __linux__ && io_uring
+#define CRL_USE_COMMON_IO
+#endif // !_MSC_VER
+
 #if defined _MSC_VER && !defined CRL_FORCE_QT
 
 #if defined _WIN64
@@ -37,15 +52,22 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #define CRL_USE_DISPATCH
 
-#ifdef CRL_USE_COMMON_QUEUE
+// The common list is used by the keyed executor lanes even with GCD queues.
 #define CRL_USE_COMMON_LIST
-#endif // CRL_USE_COMMON_QUEUE
 
 #elif __has_include(<QtCore/QThreadPool>) // __APPLE__ && !CRL_FORCE_QT
 
 #define CRL_USE_QT
 #define CRL_USE_COMMON_LIST
 
+#ifndef CRL_FORCE_QT_POOL
+#define CRL_USE_COMMON_POOL
+#endif // !CRL_FORCE_QT_POOL
+
+#ifdef CRL_USE_LINUX_FUTEX
+#define CRL_USE_COMMON_SEMAPHORE
+#endif // CRL_USE_LINUX_FUTEX
+
 #else // Qt
 #error "Configuration is not supported."
 #endif // !_MSC_VER && !__APPLE__ && !Qt
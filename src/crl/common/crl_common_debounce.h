@@ -0,0 +1,146 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_timer.h>
+#include <crl/crl_time.h>
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+namespace crl {
+namespace details {
+
+template <typename Queue, typename Callable>
+struct rate_limit_state {
+	rate_limit_state(Queue &queue, crl::time delay, Callable callable)
+	: queue(&queue)
+	, delay(delay)
+	, callable(std::move(callable))
+	, last(crl::now() - delay) {
+	}
+
+	Queue * const queue = nullptr;
+	const crl::time delay = 0;
+	Callable callable;
+
+	// Set from the first event of a burst till the callable is started.
+	std::atomic<bool> pending = false;
+	std::atomic<crl::time> last = 0;
+
+	// Keeps the state alive while the timer is armed.
+	std::shared_ptr<rate_limit_state> self;
+};
+
+template <typename State>
+void rate_limit_run(std::shared_ptr<State> self) {
+	const auto state = self.get();
+	state->queue->async([self = std::move(self)] {
+		self->last.store(crl::now(), std::memory_order_relaxed);
+		self->pending.store(false);
+		self->callable();
+	});
+}
+
+} // namespace details
+
+// Runs the callable on the queue once the events stop coming for the
+// delay, a burst of calls results in a single run after its last call.
+// A pending run happens even if all the copies were destroyed by then,
+// the queue should outlive it.
+template <typename Queue, typename Callable>
+class debounced {
+public:
+	template <typename OtherCallable>
+	debounced(Queue &queue, crl::time delay, OtherCallable &&callable)
+	: _state(std::make_shared<State>(
+		queue,
+		delay,
+		std::forward<OtherCallable>(callable))) {
+	}
+
+	void operator()() const {
+		_state->last.store(crl::now(), std::memory_order_relaxed);
+		auto expected = false;
+		if (_state->pending.compare_exchange_strong(expected, true)) {
+			_state->self = _state;
+			details::async_after(_state->delay, Fire, _state.get());
+		}
+	}
+
+private:
+	using State = details::rate_limit_state<Queue, Callable>;
+
+	static void Fire(void *that) {
+		const auto state = static_cast<State*>(that);
+		const auto passed = crl::now()
+			- state->last.load(std::memory_order_relaxed);
+		if (passed < state->delay) {
+			// Some events came after the timer was armed, wait for more.
+			details::async_after(state->delay - passed, Fire, that);
+		} else {
+			details::rate_limit_run(std::move(state->self));
+		}
+	}
+
+	std::shared_ptr<State> _state;
+
+};
+
+// Runs the callable on the queue at most once per interval, the first
+// call of a burst runs it right away and the rest are merged into one
+// run at the end of the interval.
+template <typename Queue, typename Callable>
+class throttled {
+public:
+	template <typename OtherCallable>
+	throttled(Queue &queue, crl::time interval, OtherCallable &&callable)
+	: _state(std::make_shared<State>(
+		queue,
+		interval,
+		std::forward<OtherCallable>(callable))) {
+	}
+
+	void operator()() const {
+		auto expected = false;
+		if (!_state->pending.compare_exchange_strong(expected, true)) {
+			return;
+		}
+		const auto wait = _state->last.load(std::memory_order_relaxed)
+			+ _state->delay
+			- crl::now();
+		if (wait > 0) {
+			_state->self = _state;
+			details::async_after(wait, Fire, _state.get());
+		} else {
+			details::rate_limit_run(_state);
+		}
+	}
+
+private:
+	using State = details::rate_limit_state<Queue, Callable>;
+
+	static void Fire(void *that) {
+		details::rate_limit_run(std::move(static_cast<State*>(that)->self));
+	}
+
+	std::shared_ptr<State> _state;
+
+};
+
+template <typename Queue, typename Callable>
+debounced(Queue &, crl::time, Callable &&)
+-> debounced<Queue, std::decay_t<Callable>>;
+
+template <typename Queue, typename Callable>
+throttled(Queue &, crl::time, Callable &&)
+-> throttled<Queue, std::decay_t<Callable>>;
+
+} // namespace crl
@@ -0,0 +1,80 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_event.h>
+
+namespace crl {
+
+void event::set() {
+	if (_manual) {
+		if (_state.exchange(kSetBit) & kWaiterBit) {
+			details::futex_wake_all(&_state);
+		}
+		return;
+	}
+	auto was = _state.load();
+	while (true) {
+		if (was & kSetBit) {
+			return;
+		} else if (_state.compare_exchange_weak(was, was | kSetBit)) {
+			break;
+		}
+	}
+
+	// The waiter bit is not cleared here, more waiters may be parked.
+	if (was & kWaiterBit) {
+		details::futex_wake_one(&_state);
+	}
+}
+
+bool event::try_wait() {
+	auto was = _state.load();
+	while (true) {
+		if (!(was & kSetBit)) {
+			return false;
+		} else if (_manual
+			|| _state.compare_exchange_weak(was, was & ~kSetBit)) {
+			return true;
+		}
+	}
+}
+
+template <typename Wait>
+bool event::wait_with(Wait &&wait) {
+	while (true) {
+		if (try_wait()) {
+			return true;
+		}
+		auto value = _state.load();
+		if (value & kSetBit) {
+			continue;
+		} else if (!(value & kWaiterBit)) {
+			if (!_state.compare_exchange_weak(value, value | kWaiterBit)) {
+				continue;
+			}
+			value |= kWaiterBit;
+		}
+		if (!wait(value)) {
+			return try_wait();
+		}
+	}
+}
+
+void event::wait() {
+	wait_with([&](std::uint32_t value) {
+		details::futex_wait(&_state, value);
+		return true;
+	});
+}
+
+bool event::wait_until(crl::time deadline) {
+	return wait_with([&](std::uint32_t value) {
+		return details::futex_wait_for(&_state, value, deadline - crl::now());
+	});
+}
+
+} // namespace crl
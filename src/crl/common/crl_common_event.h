@@ -0,0 +1,54 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_futex.h>
+
+namespace crl {
+
+// Manual reset event stays set until reset(), releasing every waiter.
+// Auto reset event releases a single waiter and resets itself.
+class event {
+public:
+	explicit event(bool manual_reset = false, bool initially_set = false)
+	: _manual(manual_reset)
+	, _state(initially_set ? kSetBit : 0) {
+	}
+	event(const event &other) = delete;
+	event &operator=(const event &other) = delete;
+
+	void set();
+	void reset() {
+		_state.fetch_and(~kSetBit);
+	}
+
+	[[nodiscard]] bool is_set() const {
+		return (_state.load() & kSetBit);
+	}
+
+	// Consumes the signal of an auto reset event.
+	bool try_wait();
+	void wait();
+
+	// Returns false if the deadline (in crl::now() terms) has passed.
+	bool wait_until(crl::time deadline);
+
+private:
+	static constexpr auto kSetBit = std::uint32_t(1);
+	static constexpr auto kWaiterBit = std::uint32_t(2);
+
+	template <typename Wait>
+	bool wait_with(Wait &&wait);
+
+	const bool _manual = false;
+	details::futex_value _state = 0;
+
+};
+
+} // namespace crl
@@ -0,0 +1,79 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_futex.h>
+
+#ifdef CRL_USE_COMMON_FUTEX
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace crl::details {
+namespace {
+
+constexpr auto kBucketsCount = 64;
+
+struct Bucket {
+	std::mutex mutex;
+	std::condition_variable condition;
+};
+
+Bucket Buckets[kBucketsCount];
+
+Bucket &ChooseBucket(futex_value *value) {
+	const auto address = reinterpret_cast<std::uintptr_t>(value);
+	return Buckets[(address / sizeof(futex_value)) % kBucketsCount];
+}
+
+} // namespace
+
+void futex_wait(futex_value *value, std::uint32_t expected) {
+	auto &bucket = ChooseBucket(value);
+	auto lock = std::unique_lock<std::mutex>(bucket.mutex);
+	if (value->load() == expected) {
+		bucket.condition.wait(lock);
+	}
+}
+
+bool futex_wait_for(
+		futex_value *value,
+		std::uint32_t expected,
+		crl::time timeout) {
+	auto &bucket = ChooseBucket(value);
+	auto lock = std::unique_lock<std::mutex>(bucket.mutex);
+	if (value->load() != expected) {
+		return true;
+	} else if (timeout <= 0) {
+		return false;
+	}
+	return (bucket.condition.wait_for(
+		lock,
+		std::chrono::milliseconds(timeout)) == std::cv_status::no_timeout);
+}
+
+void futex_wake_one(futex_value *value) {
+	// Different values may share a bucket, so wake everybody.
+	futex_wake_all(value);
+}
+
+void futex_wake_all(futex_value *value) {
+	auto &bucket = ChooseBucket(value);
+	{
+		const auto lock = std::lock_guard<std::mutex>(bucket.mutex);
+	}
+	bucket.condition.notify_all();
+}
+
+void futex_wake(futex_value *value, int) {
+	// Different values may share a bucket, so wake everybody.
+	futex_wake_all(value);
+}
+
+} // namespace crl::details
+
+#endif // CRL_USE_COMMON_FUTEX
@@ -0,0 +1,37 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/crl_time.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace crl::details {
+
+using futex_value = std::atomic<std::uint32_t>;
+
+static_assert(sizeof(futex_value) == sizeof(std::uint32_t));
+
+// Blocks while *value == expected. Spurious wake ups are possible.
+void futex_wait(futex_value *value, std::uint32_t expected);
+
+// Returns false if timeout (in milliseconds) has passed.
+bool futex_wait_for(
+	futex_value *value,
+	std::uint32_t expected,
+	crl::time timeout);
+
+void futex_wake_one(futex_value *value);
+void futex_wake_all(futex_value *value);
+
+// Wakes up to count waiters in one call.
+void futex_wake(futex_value *value, int count);
+
+} // namespace crl::details
@@ -0,0 +1,75 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_group.h>
+
+#include <crl/common/crl_common_sync_wait.h>
+#include <utility>
+
+namespace crl {
+
+void group::add(BasicEntry *entry) {
+	// The entry holds the group busy until it is in the list, so that
+	// the last leave() can't miss it.
+	enter();
+	auto head = _notify.load();
+	do {
+		entry->next = head;
+	} while (!_notify.compare_exchange_weak(head, entry));
+	leave();
+}
+
+void group::restore(BasicEntry *entries) {
+	auto expected = (BasicEntry*)nullptr;
+	while (!_notify.compare_exchange_strong(expected, entries)) {
+		// Entries added meanwhile are newer, keep them in front.
+		if (const auto newer = _notify.exchange(nullptr)) {
+			auto last = newer;
+			while (last->next) {
+				last = last->next;
+			}
+			last->next = entries;
+			entries = newer;
+		}
+		expected = nullptr;
+	}
+}
+
+void group::leave() {
+	auto taken = (BasicEntry*)nullptr;
+	const auto empty = _counter.decrement(1, [&] {
+		taken = _notify.exchange(nullptr);
+	}, [&] {
+		// Someone entered meanwhile, the notifications are not due yet.
+		if (const auto entries = std::exchange(taken, nullptr)) {
+			restore(entries);
+		}
+	});
+	if (!empty || !taken) {
+		return;
+	}
+
+	// The group may be destroyed already, the entries are ours now.
+	if (const auto next = taken->next) {
+		taken = details::reverse_list(taken, next);
+	}
+	while (taken) {
+		const auto next = taken->next;
+		taken->process(taken);
+		taken = next;
+	}
+}
+
+void group::wait() {
+	details::sync_wait(_counter);
+}
+
+bool group::wait_until(crl::time deadline) {
+	return _counter.wait_until(deadline);
+}
+
+} // namespace crl
@@ -0,0 +1,98 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_list.h>
+#include <crl/common/crl_common_utils.h>
+#include <crl/common/crl_common_inflight_counter.h>
+#include <crl/crl_async.h>
+#include <crl/crl_on_main.h>
+#include <atomic>
+
+namespace crl {
+
+// Tracks a set of tasks, lets wait for all of them or get notified
+// when there are none left. The counter is the only shared state,
+// so adding a task to a group costs no extra allocation.
+class group {
+public:
+	group() = default;
+	group(const group &other) = delete;
+	group &operator=(const group &other) = delete;
+
+	// Each enter() must be paired with a leave().
+	void enter() {
+		_counter.increment();
+	}
+	void leave();
+
+	// Blocks until the group becomes empty.
+	void wait();
+
+	// Same, but gives up after the deadline in crl::now() terms.
+	// Returns true if the group became empty.
+	bool wait_until(crl::time deadline);
+
+	// Runs the callable on the main thread when the group is empty.
+	template <typename Callable>
+	void notify(Callable &&callable) {
+		add(details::allocate_list_entry([
+			function = std::forward<Callable>(callable)
+		]() mutable {
+			crl::on_main(std::move(function));
+		}));
+	}
+
+	// Same, but posts the callable to the queue.
+	template <typename Queue, typename Callable>
+	void notify(Queue &queue, Callable &&callable) {
+		add(details::allocate_list_entry([
+			&queue,
+			function = std::forward<Callable>(callable)
+		]() mutable {
+			queue.async(std::move(function));
+		}));
+	}
+
+private:
+	using BasicEntry = details::list_entry<>;
+
+	void add(BasicEntry *entry);
+	void restore(BasicEntry *entries);
+
+	details::inflight_counter _counter;
+	std::atomic<BasicEntry*> _notify = nullptr;
+
+};
+
+template <typename Callable>
+inline void async(group &group, Callable &&callable) {
+	group.enter();
+	crl::async([
+		&group,
+		callable = std::forward<Callable>(callable)
+	]() mutable {
+		const auto guard = details::finally([&] { group.leave(); });
+		callable();
+	});
+}
+
+template <typename Queue, typename Callable>
+inline void async(group &group, Queue &queue, Callable &&callable) {
+	group.enter();
+	queue.async([
+		&group,
+		callable = std::forward<Callable>(callable)
+	]() mutable {
+		const auto guard = details::finally([&] { group.leave(); });
+		callable();
+	});
+}
+
+} // namespace crl
@@ -0,0 +1,68 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_inflight_counter.h>
+
+namespace crl::details {
+
+bool inflight_counter::decrement(std::uint32_t count) {
+	return decrement(count, [] {}, [] {});
+}
+
+template <typename Wait>
+bool inflight_counter::wait_with(Wait &&wait) {
+	auto value = _value.load();
+	while (true) {
+		if (!(value & kCountMask)) {
+			return true;
+		} else if (!(value & kWaiterBit)) {
+			if (!_value.compare_exchange_weak(value, value | kWaiterBit)) {
+				continue;
+			}
+			value |= kWaiterBit;
+		}
+		if (!wait(value)) {
+			return !(_value.load() & kCountMask);
+		}
+		value = _value.load();
+	}
+}
+
+void inflight_counter::wait() {
+	wait_with([&](std::uint32_t value) {
+		futex_wait(&_value, value);
+		return true;
+	});
+}
+
+bool inflight_counter::wait_until(crl::time deadline) {
+	return wait_with([&](std::uint32_t value) {
+		return futex_wait_for(&_value, value, deadline - crl::now());
+	});
+}
+
+bool inflight_counter::wait_once(crl::time timeout) {
+	auto waited = false;
+	return wait_with([&](std::uint32_t value) {
+		if (waited) {
+			return false;
+		}
+		waited = true;
+		futex_wait_for(&_value, value, timeout);
+		return true;
+	});
+}
+
+void inflight_counter::wake_waiters() {
+	// Changing the value wakes even the ones not asleep yet,
+	// they set the bit again before the next wait.
+	if (_value.fetch_and(~kWaiterBit) & kWaiterBit) {
+		futex_wake_all(&_value);
+	}
+}
+
+} // namespace crl::details
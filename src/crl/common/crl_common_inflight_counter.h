@@ -0,0 +1,89 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_futex.h>
+
+namespace crl::details {
+
+// Counts tasks in flight and lets threads wait for it to drop to zero.
+// The waiter flag is kept in the same word, so that decrements without
+// waiters never make a syscall.
+class inflight_counter {
+public:
+	// Returns true if the counter was zero.
+	bool increment(std::uint32_t count = 1) {
+		return !((_value.fetch_add(count) & kCountMask));
+	}
+
+	// Returns true if the counter became zero.
+	// The counter may be destroyed right after that by a waiter.
+	bool decrement(std::uint32_t count = 1);
+
+	// Same, but calls before_zero() right before each attempt to drop
+	// the counter to zero and zero_failed() if that attempt lost to a
+	// concurrent increment, both while the owner is still safe to access.
+	template <typename BeforeZero, typename ZeroFailed>
+	bool decrement(
+		std::uint32_t count,
+		BeforeZero &&before_zero,
+		ZeroFailed &&zero_failed);
+
+	[[nodiscard]] std::uint32_t value() const {
+		return (_value.load() & kCountMask);
+	}
+
+	void wait();
+
+	// Returns false if the deadline (in crl::now() terms) has passed.
+	bool wait_until(crl::time deadline);
+
+	// Waits for one wake up: the counter dropping to zero, a call of
+	// wake_waiters() or the timeout. Returns true if the counter is zero.
+	bool wait_once(crl::time timeout);
+
+	// Wakes the waiters up without changing the counter.
+	void wake_waiters();
+
+private:
+	static constexpr auto kWaiterBit = std::uint32_t(1) << 31;
+	static constexpr auto kCountMask = kWaiterBit - 1;
+
+	template <typename Wait>
+	bool wait_with(Wait &&wait);
+
+	futex_value _value = 0;
+
+};
+
+template <typename BeforeZero, typename ZeroFailed>
+bool inflight_counter::decrement(
+		std::uint32_t count,
+		BeforeZero &&before_zero,
+		ZeroFailed &&zero_failed) {
+	auto was = _value.load();
+	while (true) {
+		const auto now = (was & kCountMask) - count;
+		if (!now) {
+			before_zero();
+		}
+		const auto set = now ? (now | (was & kWaiterBit)) : 0;
+		if (_value.compare_exchange_weak(was, set)) {
+			if (now) {
+				return false;
+			} else if (was & kWaiterBit) {
+				futex_wake_all(&_value);
+			}
+			return true;
+		} else if (!now) {
+			zero_failed();
+		}
+	}
+}
+
+} // namespace crl::details
@@ -0,0 +1,82 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_io.h>
+
+#if defined CRL_USE_LINUX_IO || defined CRL_USE_COMMON_IO
+
+#include <crl/crl_async.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace crl::details {
+namespace {
+
+template <typename Call>
+int Retry(Call &&call) {
+	while (true) {
+		const auto result = call();
+		if (result >= 0) {
+			return int(result);
+		} else if (errno != EINTR) {
+			return -errno;
+		}
+	}
+}
+
+} // namespace
+
+int io_perform(const io_request &request) {
+	switch (request.operation) {
+	case io_operation::read:
+		return Retry([&] {
+			return pread(
+				request.fd,
+				request.buffer,
+				request.size,
+				off_t(request.offset));
+		});
+	case io_operation::write:
+		return Retry([&] {
+			return pwrite(
+				request.fd,
+				request.buffer,
+				request.size,
+				off_t(request.offset));
+		});
+	case io_operation::fsync:
+		return Retry([&] { return ::fsync(request.fd); });
+	case io_operation::openat:
+		return Retry([&] {
+			return ::openat(
+				request.fd,
+				request.path.c_str(),
+				request.flags,
+				request.mode);
+		});
+	}
+	return -EINVAL;
+}
+
+void io_submit_blocking(io_request *request) {
+	crl::async_blocking([=] {
+		request->complete(request, io_perform(*request));
+	});
+}
+
+#ifdef CRL_USE_COMMON_IO
+
+void io_submit(io_request *request) {
+	io_submit_blocking(request);
+}
+
+#endif // CRL_USE_COMMON_IO
+
+} // namespace crl::details
+
+#endif // CRL_USE_LINUX_IO || CRL_USE_COMMON_IO
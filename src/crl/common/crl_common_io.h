@@ -0,0 +1,241 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+
+#if defined CRL_USE_LINUX_IO || defined CRL_USE_COMMON_IO
+
+#include <crl/crl_on_main.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace crl::details {
+
+enum class io_operation {
+	read,
+	write,
+	fsync,
+	openat,
+};
+
+struct io_request {
+	using CompleteMethod = void(*)(io_request *request, int result);
+
+	explicit io_request(CompleteMethod method) : complete(method) {
+	}
+
+	io_operation operation = io_operation::read;
+	int fd = -1;
+	std::uint64_t offset = 0;
+	void *buffer = nullptr;
+	std::size_t size = 0;
+	int flags = 0;
+	int mode = 0;
+	std::string path;
+	CompleteMethod complete = nullptr;
+};
+
+// Starts the request, complete() is called on an arbitrary thread.
+void io_submit(io_request *request);
+
+// Performs the request on this thread, blocking.
+int io_perform(const io_request &request);
+
+// Performs the request on the blocking pool.
+void io_submit_blocking(io_request *request);
+
+template <typename Queue, typename Callback>
+struct io_request_impl : io_request {
+	io_request_impl(Queue *queue, Callback &&callback)
+	: io_request(io_request_impl::Complete)
+	, queue(queue)
+	, callback(std::move(callback)) {
+	}
+	io_request_impl(Queue *queue, const Callback &callback)
+	: io_request(io_request_impl::Complete)
+	, queue(queue)
+	, callback(callback) {
+	}
+	Queue *queue = nullptr; // Not owned, must outlive the request.
+	Callback callback;
+
+	static void Complete(io_request *request, int result) {
+		const auto that = static_cast<io_request_impl*>(request);
+		auto done = [callback = std::move(that->callback), result]() mutable {
+			callback(result);
+		};
+		const auto queue = that->queue;
+		delete that;
+		if constexpr (std::is_void_v<Queue>) {
+			crl::on_main(std::move(done));
+		} else {
+			queue->async(std::move(done));
+		}
+	}
+
+};
+
+template <typename Queue, typename Callback>
+io_request *io_create(
+		io_operation operation,
+		int fd,
+		Queue *queue,
+		Callback &&callback) {
+	using Type = io_request_impl<Queue, std::decay_t<Callback>>;
+	const auto result = new Type(queue, std::forward<Callback>(callback));
+	result->operation = operation;
+	result->fd = fd;
+	return result;
+}
+
+} // namespace crl::details
+
+namespace crl::io {
+
+// The callback receives the syscall result: the byte count or the new
+// descriptor, or a negative errno value. It is posted to the queue,
+// or to the main thread in the overloads without the queue argument.
+// The buffer and the queue must stay valid until the callback is
+// called, the completion posts to the queue without checking it.
+
+template <typename Queue, typename Callback>
+void read(
+		int fd,
+		std::uint64_t offset,
+		void *buffer,
+		std::size_t size,
+		Queue &queue,
+		Callback &&callback) {
+	const auto request = details::io_create(
+		details::io_operation::read,
+		fd,
+		&queue,
+		std::forward<Callback>(callback));
+	request->offset = offset;
+	request->buffer = buffer;
+	request->size = size;
+	details::io_submit(request);
+}
+
+template <typename Callback>
+void read(
+		int fd,
+		std::uint64_t offset,
+		void *buffer,
+		std::size_t size,
+		Callback &&callback) {
+	const auto request = details::io_create(
+		details::io_operation::read,
+		fd,
+		static_cast<void*>(nullptr),
+		std::forward<Callback>(callback));
+	request->offset = offset;
+	request->buffer = buffer;
+	request->size = size;
+	details::io_submit(request);
+}
+
+template <typename Queue, typename Callback>
+void write(
+		int fd,
+		std::uint64_t offset,
+		const void *buffer,
+		std::size_t size,
+		Queue &queue,
+		Callback &&callback) {
+	const auto request = details::io_create(
+		details::io_operation::write,
+		fd,
+		&queue,
+		std::forward<Callback>(callback));
+	request->offset = offset;
+	request->buffer = const_cast<void*>(buffer);
+	request->size = size;
+	details::io_submit(request);
+}
+
+template <typename Callback>
+void write(
+		int fd,
+		std::uint64_t offset,
+		const void *buffer,
+		std::size_t size,
+		Callback &&callback) {
+	const auto request = details::io_create(
+		details::io_operation::write,
+		fd,
+		static_cast<void*>(nullptr),
+		std::forward<Callback>(callback));
+	request->offset = offset;
+	request->buffer = const_cast<void*>(buffer);
+	request->size = size;
+	details::io_submit(request);
+}
+
+template <typename Queue, typename Callback>
+void fsync(int fd, Queue &queue, Callback &&callback) {
+	details::io_submit(details::io_create(
+		details::io_operation::fsync,
+		fd,
+		&queue,
+		std::forward<Callback>(callback)));
+}
+
+template <typename Callback>
+void fsync(int fd, Callback &&callback) {
+	details::io_submit(details::io_create(
+		details::io_operation::fsync,
+		fd,
+		static_cast<void*>(nullptr),
+		std::forward<Callback>(callback)));
+}
+
+template <typename Queue, typename Callback>
+void openat(
+		int dirfd,
+		std::string path,
+		int flags,
+		int mode,
+		Queue &queue,
+		Callback &&callback) {
+	const auto request = details::io_create(
+		details::io_operation::openat,
+		dirfd,
+		&queue,
+		std::forward<Callback>(callback));
+	request->path = std::move(path);
+	request->flags = flags;
+	request->mode = mode;
+	details::io_submit(request);
+}
+
+template <typename Callback>
+void openat(
+		int dirfd,
+		std::string path,
+		int flags,
+		int mode,
+		Callback &&callback) {
+	const auto request = details::io_create(
+		details::io_operation::openat,
+		dirfd,
+		static_cast<void*>(nullptr),
+		std::forward<Callback>(callback));
+	request->path = std::move(path);
+	request->flags = flags;
+	request->mode = mode;
+	details::io_submit(request);
+}
+
+} // namespace crl::io
+
+#endif // CRL_USE_LINUX_IO || CRL_USE_COMMON_IO
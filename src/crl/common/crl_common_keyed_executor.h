@@ -0,0 +1,172 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_list.h>
+#include <crl/common/crl_common_inflight_counter.h>
+#include <crl/crl_async.h>
+#include <crl/crl_time.h>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace crl {
+
+// Runs the tasks of each key serially and the tasks of different keys
+// in parallel, like a separate queue for each key. The lanes are created
+// on the first task for the key and destroyed when they become idle.
+// Call wait_idle() before destroying it if some tasks may still run.
+template <typename Key, typename Hash = std::hash<Key>>
+class keyed_executor {
+public:
+	keyed_executor() = default;
+	keyed_executor(const keyed_executor &other) = delete;
+	keyed_executor &operator=(const keyed_executor &other) = delete;
+	~keyed_executor();
+
+	template <typename Callable>
+	void async(const Key &key, Callable &&callable) {
+		_inflight.increment();
+		const auto lane = acquire(key);
+		if (lane->list.push_is_first(std::forward<Callable>(callable))) {
+			Wake(lane);
+		}
+	}
+
+	// Blocks until all the tasks, including the ones added while
+	// waiting, are processed. Don't call it from the executor itself.
+	void wait_idle() {
+		_inflight.wait();
+	}
+
+	// Same, but gives up after the deadline in crl::now() terms.
+	// Returns true if the executor became idle.
+	bool flush(crl::time deadline) {
+		return _inflight.wait_until(deadline);
+	}
+
+	// Returns the number of keys that have tasks queued or running.
+	[[nodiscard]] int lanes() const;
+
+private:
+	// Lanes of different keys are spread over the shards,
+	// so that posting for different keys rarely contends.
+	static constexpr auto kShards = 64;
+
+	struct Shard;
+	struct Lane {
+		Lane(keyed_executor *owner, Shard *shard, const Key &key)
+		: owner(owner)
+		, shard(shard)
+		, key(key) {
+		}
+
+		details::list list;
+		keyed_executor * const owner = nullptr;
+		Shard * const shard = nullptr;
+		const Key key;
+
+		// Tasks added and not processed yet, guarded by the shard mutex.
+		// The lane is destroyed when it drops to zero.
+		std::size_t pending = 0;
+		std::atomic<bool> queued = false;
+	};
+
+	struct alignas(64) Shard {
+		mutable std::mutex mutex;
+		std::unordered_map<Key, Lane*, Hash> lanes;
+	};
+
+	static void Wake(Lane *lane);
+	static void ProcessCallback(void *that);
+
+	Lane *acquire(const Key &key);
+	void release(Lane *lane, int processed);
+
+	std::array<Shard, kShards> _shards;
+	details::inflight_counter _inflight;
+
+};
+
+template <typename Key, typename Hash>
+keyed_executor<Key, Hash>::~keyed_executor() {
+	for (auto &shard : _shards) {
+		for (const auto &[key, lane] : shard.lanes) {
+			delete lane;
+		}
+	}
+}
+
+template <typename Key, typename Hash>
+int keyed_executor<Key, Hash>::lanes() const {
+	auto result = 0;
+	for (auto &shard : _shards) {
+		const auto lock = std::lock_guard<std::mutex>(shard.mutex);
+		result += int(shard.lanes.size());
+	}
+	return result;
+}
+
+template <typename Key, typename Hash>
+auto keyed_executor<Key, Hash>::acquire(const Key &key) -> Lane* {
+	auto &shard = _shards[Hash()(key) % kShards];
+	const auto lock = std::lock_guard<std::mutex>(shard.mutex);
+	auto &lane = shard.lanes[key];
+	if (!lane) {
+		lane = new Lane(this, &shard, key);
+	}
+	++lane->pending;
+	return lane;
+}
+
+template <typename Key, typename Hash>
+void keyed_executor<Key, Hash>::Wake(Lane *lane) {
+	auto expected = false;
+	if (lane->queued.compare_exchange_strong(expected, true)) {
+		details::async_plain(ProcessCallback, static_cast<void*>(lane));
+	}
+}
+
+template <typename Key, typename Hash>
+void keyed_executor<Key, Hash>::ProcessCallback(void *that) {
+	const auto lane = static_cast<Lane*>(that);
+	const auto owner = lane->owner;
+
+	// Only the lane itself destroys its list, kDestroyed is impossible.
+	const auto processed = lane->list.process();
+	owner->release(lane, processed);
+
+	// The executor may be destroyed by a waiter right after that.
+	owner->_inflight.decrement(std::uint32_t(processed));
+}
+
+template <typename Key, typename Hash>
+void keyed_executor<Key, Hash>::release(Lane *lane, int processed) {
+	const auto shard = lane->shard;
+	{
+		auto lock = std::unique_lock<std::mutex>(shard->mutex);
+		lane->pending -= std::size_t(processed);
+		if (!lane->pending) {
+			// Nobody else can reach the lane without the shard mutex.
+			shard->lanes.erase(lane->key);
+			lock.unlock();
+			delete lane;
+			return;
+		}
+	}
+	lane->queued.store(false);
+	if (!lane->list.empty()) {
+		Wake(lane);
+	}
+}
+
+} // namespace crl
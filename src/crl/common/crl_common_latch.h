@@ -0,0 +1,53 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_inflight_counter.h>
+
+namespace crl {
+
+// Single use counter that lets threads wait for it to reach zero.
+class latch {
+public:
+	explicit latch(int count) {
+		if (count > 0) {
+			_counter.increment(count);
+		}
+	}
+	latch(const latch &other) = delete;
+	latch &operator=(const latch &other) = delete;
+
+	// The latch may be destroyed right after it reaches zero.
+	void count_down(int count = 1) {
+		_counter.decrement(count);
+	}
+
+	[[nodiscard]] bool try_wait() const {
+		return !_counter.value();
+	}
+	void wait() {
+		_counter.wait();
+	}
+
+	// Returns false if the deadline (in crl::now() terms) has passed.
+	bool wait_until(crl::time deadline) {
+		return _counter.wait_until(deadline);
+	}
+
+	void arrive_and_wait(int count = 1) {
+		count_down(count);
+		wait();
+	}
+
+private:
+	details::inflight_counter _counter;
+
+};
+
+} // namespace crl
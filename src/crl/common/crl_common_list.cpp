@@ -11,20 +11,6 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace crl::details {
 
-list::list() : _alive(new bool(true)) {
-}
-
-auto list::ReverseList(BasicEntry *entry, BasicEntry *next) -> BasicEntry* {
-	entry->next = nullptr;
-	do {
-		auto third = next->next;
-		next->next = entry;
-		entry = next;
-		next = third;
-	} while (next);
-	return entry;
-}
-
 bool list::push_entry(BasicEntry *entry) {
 	auto head = (BasicEntry*)nullptr;
 	while (true) {
@@ -39,27 +25,29 @@ bool list::empty() const {
 	return (_head == nullptr);
 }
 
-bool list::process() {
+int list::process() {
 	if (auto entry = _head.exchange(nullptr)) {
-		const auto alive = _alive;
+		auto frame = processing_frame(this);
 		if (const auto next = entry->next) {
-			entry = ReverseList(entry, next);
+			entry = reverse_list(entry, next);
 		}
+		auto processed = 0;
 		do {
+			++processed;
 			const auto basic = entry;
 			entry = entry->next;
 			basic->process(basic);
-			if (!*alive) {
-				delete alive;
-				return false;
+			if (!frame.alive()) {
+				return kDestroyed;
 			}
 		} while (entry);
+		return processed;
 	}
-	return true;
+	return 0;
 }
 
 list::~list() {
-	*_alive = false;
+	processing_frame::destroyed(this);
 }
 
 } // namespace crl::details
@@ -8,6 +8,72 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_utils.h>
+
+#include <type_traits>
+
+namespace crl::details {
+
+struct no_entry_data {
+};
+
+// Intrusive entry of a lock-free task list. Data holds the additional
+// fields some of the queues keep next to each task.
+template <typename Data = no_entry_data>
+struct list_entry : Data {
+	using ProcessMethod = void(*)(list_entry *entry);
+
+	explicit list_entry(ProcessMethod method) : process(method) {
+	}
+
+	list_entry *next = nullptr;
+	ProcessMethod process = nullptr;
+};
+
+template <typename Data, typename Function>
+struct list_entry_with final : list_entry<Data> {
+	template <typename Callable>
+	explicit list_entry_with(Callable &&callable)
+	: list_entry<Data>(list_entry_with::Process)
+	, function(std::forward<Callable>(callable)) {
+	}
+
+	Function function;
+
+	// Invokes the task and deletes the entry.
+	static void Process(list_entry<Data> *entry) {
+		auto full = static_cast<list_entry_with*>(entry);
+		auto guard = details::finally([=] { delete full; });
+		full->function();
+	}
+
+};
+
+template <typename Data = no_entry_data, typename Callable>
+list_entry<Data> *allocate_list_entry(Callable &&callable) {
+	using Function = std::decay_t<Callable>;
+	using Type = list_entry_with<Data, Function>;
+
+	return new Type(std::forward<Callable>(callable));
+}
+
+// Reverses the entries popped from a lock-free stack into the order
+// they were pushed in, returns the new first entry.
+template <typename Data>
+list_entry<Data> *reverse_list(
+		list_entry<Data> *entry,
+		list_entry<Data> *next) {
+	entry->next = nullptr;
+	do {
+		auto third = next->next;
+		next->next = entry;
+		entry = next;
+		next = third;
+	} while (next);
+	return entry;
+}
+
+} // namespace crl::details
 
 #if defined CRL_USE_WINAPI_LIST
 
@@ -15,7 +81,6 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #elif defined CRL_USE_COMMON_LIST // CRL_USE_WINAPI_LIST
 
-#include <crl/common/crl_common_utils.h>
 #include <crl/crl_semaphore.h>
 #include <atomic>
 
@@ -23,64 +88,28 @@ namespace crl::details {
 
 class list {
 public:
-	list();
+	list() = default;
+	list(const list &other) = delete;
+	list &operator=(const list &other) = delete;
 
 	template <typename Callable>
 	bool push_is_first(Callable &&callable) {
-		return push_entry(AllocateEntry(std::forward<Callable>(callable)));
+		return push_entry(
+			allocate_list_entry(std::forward<Callable>(callable)));
 	}
-	bool process();
+	// Returns the number of processed entries or kDestroyed.
+	static constexpr auto kDestroyed = -1;
+	int process();
 	bool empty() const;
 
 	~list();
 
 private:
-	struct BasicEntry;
-	using ProcessEntryMethod = void(*)(BasicEntry *entry);
-
-	struct BasicEntry {
-		BasicEntry(ProcessEntryMethod method) : process(method) {
-		}
-
-		BasicEntry *next = nullptr;
-		ProcessEntryMethod process = nullptr;
-	};
-
-	template <typename Function>
-	struct Entry : BasicEntry {
-		Entry(Function &&function)
-		: BasicEntry(Entry::Process)
-		, function(std::move(function)) {
-		}
-		Entry(const Function &function)
-		: BasicEntry(Entry::Process)
-		, function(function) {
-		}
-		Function function;
-
-		static void Process(BasicEntry *entry) {
-			auto full = static_cast<Entry*>(entry);
-			auto guard = details::finally([=] { delete full; });
-			full->function();
-		}
-
-	};
-
-	template <typename Callable>
-	static Entry<std::decay_t<Callable>> *AllocateEntry(
-			Callable &&callable) {
-		using Function = std::decay_t<Callable>;
-		using Type = Entry<Function>;
-
-		return new Type(std::forward<Callable>(callable));
-	}
-
-	static BasicEntry *ReverseList(BasicEntry *entry, BasicEntry *next);
+	using BasicEntry = list_entry<>;
 
 	bool push_entry(BasicEntry *entry);
 
 	std::atomic<BasicEntry*> _head = nullptr;
-	bool *_alive = nullptr;
 
 };
 
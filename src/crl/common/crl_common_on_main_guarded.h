@@ -17,6 +17,12 @@ namespace crl::details {
 template <typename T>
 constexpr std::size_t dependent_zero = 0;
 
+// Specialized for guards that can drop pending tasks when they die.
+template <typename GuardType, typename Enable = void>
+struct guard_pending_traits {
+	static constexpr bool purgeable = false;
+};
+
 } // namespace crl::details
 
 namespace crl {
@@ -45,6 +51,13 @@ public:
 	, _callable(std::forward<Callable>(callable)) {
 	}
 
+	[[nodiscard]] bool alive() const {
+		return GuardTraits::check(_guard);
+	}
+	[[nodiscard]] const GuardType &get_guard() const {
+		return _guard;
+	}
+
 	template <
 		typename ...OtherArgs,
 		typename Return = decltype(
@@ -97,9 +110,18 @@ template <
 	typename = std::enable_if_t<
 		sizeof(GuardTraits) != details::dependent_zero<GuardTraits>>>
 inline void on_main(Guard &&object, Callable &&callable) {
-	return on_main(guard(
+	auto wrap = guard(
 		std::forward<Guard>(object),
-		std::forward<Callable>(callable)));
+		std::forward<Callable>(callable));
+	using Pending = details::guard_pending_traits<
+		typename decltype(wrap)::GuardType>;
+	if (!wrap.alive()) {
+		return;
+	} else if constexpr (Pending::purgeable) {
+		on_main(Pending::attach(std::move(wrap)));
+	} else {
+		on_main(std::move(wrap));
+	}
 }
 
 template <
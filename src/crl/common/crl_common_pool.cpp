@@ -0,0 +1,602 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_pool.h>
+
+#ifdef CRL_USE_COMMON_POOL
+
+#include <crl/common/crl_common_async.h>
+#include <crl/common/crl_common_futex.h>
+#include <crl/common/crl_common_sync_wait.h>
+#include <crl/common/crl_common_topology.h>
+#include <crl/common/crl_common_utils.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace crl::details {
+namespace {
+
+class Pool;
+
+// Workers of one NUMA node with their own task queue.
+class Group {
+public:
+	Group(Pool *pool, int index, std::vector<int> cpus);
+
+	void push(void (*callable)(void*), void *argument);
+	void spawn_minimum();
+	void wake_all();
+	void add_statistics(pool_stats &stats);
+
+	// Runs other tasks until done() returns true. Waits with
+	// wait_for(timeout) when there is nothing to run, push() interrupts
+	// that wait with kick(), called under the group lock.
+	template <typename Done, typename WaitFor, typename Kick>
+	void help_until(Done &&done, WaitFor &&wait_for, Kick &&kick);
+
+	// Lets one more worker run meanwhile, so that the blocked worker
+	// doesn't hold the tasks it waits for.
+	template <typename Wait>
+	void block_on(Wait &&wait);
+
+	[[nodiscard]] Pool *pool() const {
+		return _pool;
+	}
+
+private:
+	friend class Pool;
+
+	struct Task {
+		void (*callable)(void*) = nullptr;
+		void *argument = nullptr;
+	};
+
+	// A worker in help_until() with nothing to run.
+	struct Helper {
+		void (*kick)(void*) = nullptr;
+		void *argument = nullptr;
+		Helper *next = nullptr;
+		bool kicked = false;
+	};
+
+	bool try_pop(Task &task);
+	bool try_steal(Task &task);
+	bool add_helper(Helper &helper);
+	bool remove_helper(Helper &helper);
+	void wake_or_spawn();
+	bool try_spawn();
+	bool try_add_thread();
+	bool try_retire(int above);
+	void run();
+	bool wait_for_task();
+
+	Pool * const _pool = nullptr;
+	const int _index = 0;
+	const std::vector<int> _cpus;
+
+	std::mutex _mutex;
+	std::deque<Task> _tasks;
+	Helper *_helpers = nullptr;
+	std::atomic<int> _queued = 0;
+
+	std::atomic<int> _threads = 0;
+	std::atomic<int> _busy = 0;
+	std::atomic<int> _spinning = 0;
+	std::atomic<int> _parked = 0;
+	std::atomic<int> _waiting = 0;
+	std::atomic<int> _blocked = 0;
+	futex_value _signal = 0;
+
+};
+
+class Pool {
+public:
+	static Pool &Instance();
+	static Pool &Blocking();
+
+	void configure(const pool_settings &settings);
+	pool_stats statistics();
+	void push(int node, void (*callable)(void*), void *argument);
+
+	[[nodiscard]] int nodes() const {
+		return int(_groups.size());
+	}
+
+private:
+	friend class Group;
+
+	explicit Pool(bool blocking);
+
+	[[nodiscard]] int current_node() const;
+
+	const bool _blocking = false;
+
+	std::vector<std::unique_ptr<Group>> _groups;
+	mutable std::atomic<unsigned> _nextNode = 0;
+
+	std::atomic<int> _minThreads = 0;
+	std::atomic<int> _maxThreads = 0;
+	std::atomic<profile_time> _spinTime = 0;
+	std::atomic<time> _idleTimeout = 0;
+	std::atomic<time> _deadlockTimeout = 0;
+	std::atomic<bool> _pinThreads = false;
+	std::atomic<bool> _crossNodeStealing = false;
+
+};
+
+constexpr auto kBlockingThreads = 64;
+
+// Deeper sync calls block, so that the worker stack stays bounded.
+constexpr auto kMaxHelpDepth = 16;
+
+// Helping workers recheck the task queues that often.
+constexpr auto kMinHelpPoll = crl::time(1);
+constexpr auto kMaxHelpPoll = crl::time(16);
+
+thread_local Group *CurrentGroup/* = nullptr*/;
+thread_local int HelpDepth/* = 0*/;
+
+std::atomic<pool_deadlock_handler> DeadlockHandler/* = nullptr*/;
+
+pool_settings BlockingDefaults() {
+	auto result = pool_settings();
+	result.spin_time = 0;
+	result.idle_timeout = 5000;
+	return result;
+}
+
+Group::Group(Pool *pool, int index, std::vector<int> cpus)
+: _pool(pool)
+, _index(index)
+, _cpus(std::move(cpus)) {
+}
+
+void Group::push(void (*callable)(void*), void *argument) {
+	{
+		const auto lock = std::lock_guard<std::mutex>(_mutex);
+		_tasks.push_back({ callable, argument });
+		++_queued;
+
+		// An idle helper can't leave help_until() while it is listed.
+		if (const auto helper = _helpers) {
+			_helpers = helper->next;
+			helper->kicked = true;
+			helper->kick(helper->argument);
+			return;
+		}
+	}
+
+	// A spinning worker will take the task and wake another one.
+	if (!_spinning.load()) {
+		wake_or_spawn();
+	}
+}
+
+void Group::spawn_minimum() {
+	while (_threads.load() < _pool->_minThreads.load() && try_spawn()) {
+	}
+}
+
+void Group::wake_all() {
+	++_signal;
+	futex_wake_all(&_signal);
+}
+
+void Group::add_statistics(pool_stats &stats) {
+	stats.threads += _threads.load();
+	stats.busy += _busy.load();
+	stats.spinning += _spinning.load();
+	stats.parked += _parked.load();
+	stats.queued += _queued.load();
+	stats.waiting += _waiting.load();
+	stats.blocked += _blocked.load();
+}
+
+template <typename Done, typename WaitFor, typename Kick>
+void Group::help_until(Done &&done, WaitFor &&wait_for, Kick &&kick) {
+	++HelpDepth;
+	++_waiting;
+	auto task = Task();
+	auto helper = Helper();
+	helper.kick = [](void *kick) {
+		(*static_cast<std::remove_reference_t<Kick>*>(kick))();
+	};
+	helper.argument = &kick;
+	auto poll = kMinHelpPoll;
+	auto progress = crl::now();
+	auto reported = false;
+	while (!done()) {
+		if (try_pop(task) || try_steal(task)) {
+			task.callable(task.argument);
+			poll = kMinHelpPoll;
+			progress = crl::now();
+			continue;
+		} else if (!add_helper(helper)) {
+			continue;
+		}
+		wait_for(poll);
+		if (remove_helper(helper)) {
+			poll = kMinHelpPoll;
+			continue;
+		}
+
+		// Tasks stolen from the other nodes are still polled for.
+		poll = std::min(poll * 2, kMaxHelpPoll);
+		if (reported
+			|| _waiting.load() < _busy.load()
+			|| crl::now() - progress < _pool->_deadlockTimeout.load()) {
+			continue;
+		}
+		reported = true;
+		if (const auto handler = DeadlockHandler.load()) {
+			handler(_pool->statistics());
+		}
+	}
+	--_waiting;
+	--HelpDepth;
+}
+
+template <typename Wait>
+void Group::block_on(Wait &&wait) {
+	++_blocked;
+	if (_queued.load()) {
+		wake_or_spawn();
+	}
+	wait();
+
+	// Let the parked extra worker leave, see wait_for_task().
+	if (--_blocked < _threads.load() - _pool->_maxThreads.load()
+		&& _parked.load() > 0) {
+		++_signal;
+		futex_wake_one(&_signal);
+	}
+}
+
+bool Group::try_pop(Task &task) {
+	if (!_queued.load(std::memory_order_relaxed)) {
+		return false;
+	}
+	const auto lock = std::lock_guard<std::mutex>(_mutex);
+	if (_tasks.empty()) {
+		return false;
+	}
+	task = _tasks.front();
+	_tasks.pop_front();
+	--_queued;
+	return true;
+}
+
+bool Group::add_helper(Helper &helper) {
+	const auto lock = std::lock_guard<std::mutex>(_mutex);
+	if (_queued.load()) {
+		return false;
+	}
+	helper.kicked = false;
+	helper.next = _helpers;
+	_helpers = &helper;
+	return true;
+}
+
+bool Group::remove_helper(Helper &helper) {
+	const auto lock = std::lock_guard<std::mutex>(_mutex);
+	if (helper.kicked) {
+		return true;
+	}
+	auto link = &_helpers;
+	while (*link != &helper) {
+		link = &(*link)->next;
+	}
+	*link = helper.next;
+	return false;
+}
+
+bool Group::try_steal(Task &task) {
+	if (!_pool->_crossNodeStealing.load(std::memory_order_relaxed)) {
+		return false;
+	}
+	const auto count = _pool->nodes();
+	for (auto i = 1; i != count; ++i) {
+		const auto other = _pool->_groups[(_index + i) % count].get();
+		if (other->try_pop(task)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void Group::wake_or_spawn() {
+	if (_parked.load() > 0) {
+		++_signal;
+		futex_wake_one(&_signal);
+	} else {
+		try_spawn();
+	}
+}
+
+bool Group::try_spawn() {
+	if (!try_add_thread()) {
+		return false;
+	}
+	std::thread([this] { run(); }).detach();
+	return true;
+}
+
+bool Group::try_add_thread() {
+	auto threads = _threads.load();
+	while (threads < _pool->_maxThreads.load() + _blocked.load()) {
+		if (_threads.compare_exchange_weak(threads, threads + 1)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Group::try_retire(int above) {
+	auto threads = _threads.load();
+	while (threads > above) {
+		if (_threads.compare_exchange_weak(threads, threads - 1)) {
+			// A push before the decrement could find no one to wake
+			// and no room for a new worker, stay for its task then.
+			return !_queued.load() || !try_add_thread();
+		}
+	}
+	return false;
+}
+
+void Group::run() {
+	CurrentGroup = this;
+	if (_pool->_pinThreads.load()) {
+		pin_current_thread(_cpus);
+	}
+	auto task = Task();
+	while (true) {
+		if (try_pop(task) || try_steal(task)) {
+			// Pushes made while someone was spinning didn't wake anyone,
+			// so each worker that takes a task wakes the next one.
+			if (_queued.load(std::memory_order_relaxed)
+				&& !_spinning.load()) {
+				wake_or_spawn();
+			}
+			++_busy;
+			task.callable(task.argument);
+			--_busy;
+		} else if (!wait_for_task()) {
+			return;
+		}
+	}
+}
+
+bool Group::wait_for_task() {
+	// Workers spawned for the blocked ones leave once they are idle.
+	if (try_retire(_pool->_maxThreads.load() + _blocked.load())) {
+		return false;
+	}
+	++_spinning;
+	const auto till = crl::profile() + _pool->_spinTime.load();
+	while (!_queued.load(std::memory_order_relaxed)) {
+		if (crl::profile() >= till) {
+			break;
+		}
+		cpu_relax();
+	}
+	const auto signal = _signal.load();
+	if (_queued.load()) {
+		if (_spinning.fetch_sub(1) == 1 && _queued.load() > 1) {
+			wake_or_spawn();
+		}
+		return true;
+	}
+	++_parked;
+	--_spinning;
+	if (_queued.load()) {
+		--_parked;
+		return true;
+	}
+	const auto timeout = _pool->_idleTimeout.load();
+	const auto woken = futex_wait_for(&_signal, signal, timeout);
+	--_parked;
+	if (woken || _queued.load()) {
+		return true;
+	}
+	return !try_retire(_pool->_minThreads.load());
+}
+
+Pool &Pool::Instance() {
+	// Leaked intentionally, workers may outlive static destructors.
+	static const auto result = new Pool(false);
+	return *result;
+}
+
+Pool &Pool::Blocking() {
+	static const auto result = new Pool(true);
+	return *result;
+}
+
+Pool::Pool(bool blocking) : _blocking(blocking) {
+	if (_blocking) {
+		// Blocked workers don't use CPU, NUMA grouping is pointless.
+		_groups.push_back(
+			std::make_unique<Group>(this, 0, std::vector<int>()));
+		configure(BlockingDefaults());
+		return;
+	}
+	auto index = 0;
+	for (auto &cpus : numa_nodes()) {
+		_groups.push_back(
+			std::make_unique<Group>(this, index++, std::move(cpus)));
+	}
+	configure(pool_settings());
+}
+
+void Pool::configure(const pool_settings &settings) {
+	const auto count = nodes();
+	const auto hardware = int(std::thread::hardware_concurrency());
+	const auto fallback = _blocking ? kBlockingThreads : hardware;
+	const auto total = std::max(
+		settings.max_threads ? settings.max_threads : fallback,
+		1);
+
+	// The limits are split between the NUMA nodes.
+	const auto max = std::max((total + count - 1) / count, 1);
+	_maxThreads = max;
+	_minThreads = std::clamp(
+		(settings.min_threads + count - 1) / count,
+		0,
+		max);
+	_spinTime = std::max(settings.spin_time, profile_time(0));
+	_idleTimeout = std::max(settings.idle_timeout, time(1));
+	_deadlockTimeout = std::max(settings.deadlock_timeout, time(1));
+	_pinThreads = settings.pin_threads;
+	_crossNodeStealing = settings.cross_node_stealing;
+
+	for (const auto &group : _groups) {
+		group->spawn_minimum();
+
+		// Let the parked workers notice the new limits.
+		group->wake_all();
+	}
+}
+
+pool_stats Pool::statistics() {
+	auto result = pool_stats();
+	for (const auto &group : _groups) {
+		group->add_statistics(result);
+	}
+	result.max_threads = _maxThreads.load() * nodes();
+	result.utilisation = double(result.busy) / result.max_threads;
+	return result;
+}
+
+int Pool::current_node() const {
+	if (CurrentGroup && CurrentGroup->_pool == this) {
+		return CurrentGroup->_index;
+	} else if (nodes() == 1) {
+		return 0;
+	}
+	// Spread the tasks from outside of the pool between the nodes,
+	// so that a single producer thread loads all of them.
+	return int(_nextNode.fetch_add(1, std::memory_order_relaxed)
+		% unsigned(nodes()));
+}
+
+void Pool::push(int node, void (*callable)(void*), void *argument) {
+	const auto index = (node >= 0 && node < nodes())
+		? node
+		: current_node();
+	_groups[index]->push(callable, argument);
+}
+
+Group *WaitingGroup() {
+	// Blocking pool tasks may wait for long, they don't help.
+	const auto group = CurrentGroup;
+	return (group && group->pool() == &Pool::Instance()) ? group : nullptr;
+}
+
+bool HelpAllowed() {
+	// A task helped from inside a serial queue or a strand could sync()
+	// into that queue and wait for its own caller down the stack.
+	return (HelpDepth < kMaxHelpDepth) && !processing_frame::inside();
+}
+
+} // namespace
+
+void async_plain(void (*callable)(void*), void *argument) {
+	Pool::Instance().push(-1, callable, argument);
+}
+
+void async_plain_on(int node, void (*callable)(void*), void *argument) {
+	Pool::Instance().push(node, callable, argument);
+}
+
+void async_blocking_plain(void (*callable)(void*), void *argument) {
+	Pool::Blocking().push(0, callable, argument);
+}
+
+void sync_wait(semaphore &waiter) {
+	strand_blocking();
+	const auto group = WaitingGroup();
+	if (!group) {
+		waiter.acquire();
+	} else if (HelpAllowed()) {
+		// Group::push() kicks us with a release of its own,
+		// it is taken back here.
+		auto kicks = 0;
+		group->help_until([&] {
+			for (; waiter.try_acquire(); --kicks) {
+				if (!kicks) {
+					return true;
+				}
+			}
+			return false;
+		}, [&](crl::time timeout) {
+			if (waiter.acquire_for(timeout)) {
+				waiter.release();
+			}
+		}, [&] {
+			++kicks;
+			waiter.release();
+		});
+	} else {
+		group->block_on([&] { waiter.acquire(); });
+	}
+}
+
+void sync_wait(inflight_counter &counter) {
+	strand_blocking();
+	const auto group = WaitingGroup();
+	if (!group) {
+		counter.wait();
+	} else if (HelpAllowed()) {
+		group->help_until([&] {
+			return !counter.value();
+		}, [&](crl::time timeout) {
+			counter.wait_once(timeout);
+		}, [&] {
+			counter.wake_waiters();
+		});
+	} else {
+		group->block_on([&] { counter.wait(); });
+	}
+}
+
+} // namespace crl::details
+
+namespace crl {
+
+void configure_pool(const pool_settings &settings) {
+	details::Pool::Instance().configure(settings);
+}
+
+pool_stats pool_statistics() {
+	return details::Pool::Instance().statistics();
+}
+
+int pool_nodes() {
+	return details::Pool::Instance().nodes();
+}
+
+void configure_blocking_pool(const pool_settings &settings) {
+	details::Pool::Blocking().configure(settings);
+}
+
+pool_stats blocking_pool_statistics() {
+	return details::Pool::Blocking().statistics();
+}
+
+void set_pool_deadlock_handler(pool_deadlock_handler handler) {
+	details::DeadlockHandler = handler;
+}
+
+} // namespace crl
+
+#endif // CRL_USE_COMMON_POOL
@@ -0,0 +1,81 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+
+#ifdef CRL_USE_COMMON_POOL
+
+#include <crl/crl_time.h>
+
+namespace crl {
+
+struct pool_settings {
+	// Zero max_threads means std::thread::hardware_concurrency().
+	int min_threads = 0;
+	int max_threads = 0;
+
+	// Idle workers spin that long (in microseconds) before parking.
+	profile_time spin_time = 50;
+
+	// Parked workers above min_threads exit after that long.
+	time idle_timeout = 10000;
+
+	// Workers are grouped by NUMA nodes, the thread limits are split
+	// between the groups. Tasks posted from a worker stay on its node,
+	// tasks from other threads are spread between the nodes in turn.
+	// Optionally pin workers to their node CPUs and let idle groups
+	// take tasks from other nodes.
+	bool pin_threads = false;
+	bool cross_node_stealing = false;
+
+	// See crl::set_pool_deadlock_handler().
+	time deadlock_timeout = 10000;
+};
+
+struct pool_stats {
+	int threads = 0;
+	int max_threads = 0;
+	int busy = 0;
+	int spinning = 0;
+	int parked = 0;
+	int queued = 0;
+
+	// Workers waiting in sync calls, they run other tasks meanwhile.
+	int waiting = 0;
+
+	// Workers blocked in sync calls, as many extra workers may run
+	// above max_threads meanwhile.
+	int blocked = 0;
+
+	// Part of max_threads that is running tasks right now.
+	double utilisation = 0.;
+};
+
+// Thread-safe.
+void configure_pool(const pool_settings &settings);
+[[nodiscard]] pool_stats pool_statistics();
+
+// Valid crl::queue home nodes are [0, pool_nodes()).
+[[nodiscard]] int pool_nodes();
+
+// Called on a worker that waited in a sync call for deadlock_timeout
+// while all the busy workers of its node were waiting as well and there
+// was nothing to run, so it is likely that no progress is possible.
+using pool_deadlock_handler = void(*)(const pool_stats &stats);
+void set_pool_deadlock_handler(pool_deadlock_handler handler);
+
+// Separate elastic pool for crl::async_blocking() and blocking queues,
+// so that tasks waiting in syscalls don't hold the CPU workers. Here
+// zero max_threads means 64, pool_stats::busy counts blocked workers.
+void configure_blocking_pool(const pool_settings &settings);
+[[nodiscard]] pool_stats blocking_pool_statistics();
+
+} // namespace crl
+
+#endif // CRL_USE_COMMON_POOL
@@ -9,28 +9,130 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
 
+#include <crl/common/crl_common_concurrent_queue.h>
 #include <crl/crl_async.h>
 
 namespace crl {
+namespace {
+
+static_assert(sizeof(queue) <= 32);
+
+details::inflight_counter BusyQueues;
+
+// There is only one main queue at a time.
+main_queue_processor MainProcessor/* = nullptr*/;
+
+} // namespace
 
 queue::queue() = default;
 
-queue::queue(main_queue_processor processor) : _main_processor(processor) {
+queue::queue(int home_node) : _home_node(std::int16_t(home_node)) {
+}
+
+queue::queue(blocking_t) : _home_node(kBlockingNode) {
+}
+
+queue::queue(main_queue_processor processor) : _target(kTargetMain) {
+	MainProcessor = processor;
+}
+
+queue::~queue() {
+	// Destroyed with tasks in flight, for example from its own task,
+	// process() won't get to finished() then.
+	if (_inflight.value() && !is_main()) {
+		BusyQueues.decrement();
+	}
 }
 
 void queue::wake_async() {
 	auto expected = false;
-	if (_queued.compare_exchange_strong(expected, true)) {
-		(_main_processor ? _main_processor : details::async_plain)(
+	if (!_queued.compare_exchange_strong(expected, true)) {
+		return;
+	}
+	switch (_target & kTargetMask) {
+	case kTargetMain:
+		MainProcessor(ProcessCallback, static_cast<void*>(this));
+		return;
+	case kTargetQueue:
+		// The target drains us inline, no thread switch per level.
+		target<queue>()->async([=] { process(); });
+		return;
+	case kTargetConcurrent:
+		target<concurrent_queue>()->async([=] { process(); });
+		return;
+	}
+#ifdef CRL_USE_COMMON_POOL
+	if (_home_node == kBlockingNode) {
+		details::async_blocking_plain(
 			ProcessCallback,
 			static_cast<void*>(this));
+		return;
+	} else if (_home_node >= 0) {
+		details::async_plain_on(
+			_home_node,
+			ProcessCallback,
+			static_cast<void*>(this));
+		return;
 	}
+#endif // CRL_USE_COMMON_POOL
+	details::async_plain(ProcessCallback, static_cast<void*>(this));
 }
 
 void queue::process() {
-	if (!_list.process()) {
+	const auto processed = _list.process();
+	if (processed == details::list::kDestroyed) {
 		return;
 	}
+	leave();
+	finished(processed);
+}
+
+void queue::set_target(queue &target) {
+	_target = reinterpret_cast<std::uintptr_t>(&target) | kTargetQueue;
+}
+
+void queue::set_target(concurrent_queue &target) {
+	_target = reinterpret_cast<std::uintptr_t>(&target) | kTargetConcurrent;
+}
+
+bool queue::try_enter() {
+	if (_target || !_list.empty()) {
+		return false;
+	}
+	auto expected = false;
+	if (!_queued.compare_exchange_strong(expected, true)) {
+		return false;
+	} else if (!_list.empty()) {
+		leave();
+		return false;
+	}
+	started();
+	return true;
+}
+
+void queue::started() {
+	if (_inflight.increment() && !is_main()) {
+		BusyQueues.increment();
+	}
+}
+
+void queue::finished(int count) {
+	// The queue may be destroyed by a waiter right after it becomes idle.
+	const auto main = is_main();
+	if (_inflight.decrement(count) && !main) {
+		BusyQueues.decrement();
+	}
+}
+
+void queue::wait_idle() {
+	_inflight.wait();
+}
+
+bool queue::flush(crl::time deadline) {
+	return _inflight.wait_until(deadline);
+}
+
+void queue::leave() {
 	_queued.store(false);
 
 	if (!_list.empty()) {
@@ -42,6 +144,14 @@ void queue::ProcessCallback(void *that) {
 	static_cast<queue*>(that)->process();
 }
 
+void wait_all_idle() {
+	BusyQueues.wait();
+}
+
+bool flush_all(crl::time deadline) {
+	return BusyQueues.wait_until(deadline);
+}
+
 } // namespace crl
 
 #endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
@@ -13,21 +13,42 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include <crl/common/crl_common_list.h>
 #include <crl/common/crl_common_utils.h>
+#include <crl/common/crl_common_inflight_counter.h>
+#include <crl/common/crl_common_sync_wait.h>
+#include <crl/crl_time.h>
 #include <atomic>
+#include <cstdint>
 
 namespace crl {
 namespace details {
 class main_queue_pointer;
 } // namespace details
 
+class concurrent_queue;
+
+struct blocking_t {
+	explicit blocking_t() = default;
+};
+inline constexpr auto blocking = blocking_t();
+
 class queue {
 public:
 	queue();
+
+	// Processes the tasks on the pool workers of the given NUMA node.
+	// The node is ignored if the pool is not grouped by nodes.
+	explicit queue(int home_node);
+
+	// Processes the tasks on the blocking pool, see crl::async_blocking().
+	explicit queue(blocking_t);
+
 	queue(const queue &other) = delete;
 	queue &operator=(const queue &other) = delete;
+	~queue();
 
 	template <typename Callable>
 	void async(Callable &&callable) {
+		started();
 		if (_list.push_is_first(std::forward<Callable>(callable))) {
 			wake_async();
 		}
@@ -35,17 +56,50 @@ public:
 
 	template <typename Callable>
 	void sync(Callable &&callable) {
+		if (try_enter()) {
+			// Nothing is queued or running, invoke on this thread.
+			const auto guard = details::finally([&] {
+				leave();
+				finished(1);
+			});
+			callable();
+			return;
+		}
 		semaphore waiter;
 		async([&] {
 			const auto guard = details::finally([&] { waiter.release(); });
 			callable();
 		});
-		waiter.acquire();
+		details::sync_wait(waiter);
 	}
 
+	// Processes this queue inside the target one, on its thread and
+	// in its order, so that a serial target limits a whole subsystem.
+	// Should be called before any tasks are added to this queue.
+	void set_target(queue &target);
+
+	// Same, but the batches of this queue share the parallelism limit
+	// of the target with the other tasks, still running one at a time.
+	void set_target(concurrent_queue &target);
+
+	// Blocks until all the tasks, including the ones added while
+	// waiting, are processed. Don't call it from the queue itself.
+	void wait_idle();
+
+	// Same, but gives up after the deadline in crl::now() terms.
+	// Returns true if the queue became idle.
+	bool flush(crl::time deadline);
+
 private:
 	friend class details::main_queue_pointer;
 
+	static constexpr auto kBlockingNode = std::int16_t(-2);
+
+	static constexpr auto kTargetQueue = std::uintptr_t(1);
+	static constexpr auto kTargetConcurrent = std::uintptr_t(2);
+	static constexpr auto kTargetMain = std::uintptr_t(3);
+	static constexpr auto kTargetMask = std::uintptr_t(3);
+
 	static void ProcessCallback(void *that);
 
 	queue(main_queue_processor processor);
@@ -53,12 +107,35 @@ private:
 	void wake_async();
 	void process();
 
-	main_queue_processor _main_processor = nullptr;
+	bool try_enter();
+	void leave();
+
+	void started();
+	void finished(int count);
+
+	[[nodiscard]] bool is_main() const {
+		return (_target == kTargetMain);
+	}
+	template <typename Type>
+	[[nodiscard]] Type *target() const {
+		return reinterpret_cast<Type*>(_target & ~kTargetMask);
+	}
+
+	// Kept small, some clients create a queue for each object they have.
+	// The target word is a tagged pointer to the target queue or the
+	// main queue marker, the main queue processor is kept globally.
 	details::list _list;
+	std::uintptr_t _target = 0;
+	details::inflight_counter _inflight;
+	std::int16_t _home_node = -1;
 	std::atomic<bool> _queued = false;
 
 };
 
+// Blocks until all the queues except the main one become idle.
+void wait_all_idle();
+bool flush_all(crl::time deadline);
+
 } // namespace crl
 
 #endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
@@ -0,0 +1,58 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_scope.h>
+
+#include <crl/common/crl_common_sync_wait.h>
+
+#include <algorithm>
+
+namespace crl {
+
+scope::scope() = default;
+
+scope::scope(scope &parent) : _parent(&parent) {
+	_parent->add_child(this);
+}
+
+scope::~scope() {
+	join();
+	if (_parent) {
+		_parent->remove_child(this);
+	}
+}
+
+void scope::join() {
+	details::sync_wait(_inflight);
+}
+
+void scope::cancel() {
+	if (_cancelled.exchange(true)) {
+		return;
+	}
+	const auto lock = std::lock_guard<std::mutex>(_mutex);
+	for (const auto child : _children) {
+		child->cancel();
+	}
+}
+
+void scope::add_child(scope *child) {
+	const auto lock = std::lock_guard<std::mutex>(_mutex);
+	_children.push_back(child);
+	if (cancelled()) {
+		child->_cancelled = true;
+	}
+}
+
+void scope::remove_child(scope *child) {
+	const auto lock = std::lock_guard<std::mutex>(_mutex);
+	_children.erase(
+		std::remove(begin(_children), end(_children), child),
+		end(_children));
+}
+
+} // namespace crl
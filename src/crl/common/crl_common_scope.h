@@ -0,0 +1,83 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_inflight_counter.h>
+#include <crl/crl_async.h>
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace crl {
+
+// Owns the tasks started through it: join() and the destructor wait
+// until all of them finish, so the tasks may capture references to
+// anything that outlives the scope. A pool worker keeps running other
+// tasks while it waits, see details::sync_wait().
+//
+// Cancelling a scope cancels its child scopes as well. Tasks that didn't
+// start yet are skipped, the running ones may check cancelled().
+class scope {
+public:
+	scope();
+	explicit scope(scope &parent);
+	scope(const scope &other) = delete;
+	scope &operator=(const scope &other) = delete;
+	~scope();
+
+	template <typename Callable>
+	void async(Callable &&callable) {
+		_inflight.increment();
+		crl::async(wrap(std::forward<Callable>(callable)));
+	}
+
+	template <typename Queue, typename Callable>
+	void async(Queue &queue, Callable &&callable) {
+		_inflight.increment();
+		queue.async(wrap(std::forward<Callable>(callable)));
+	}
+
+	// Don't call it from a task of this scope.
+	void join();
+
+	void cancel();
+	[[nodiscard]] bool cancelled() const {
+		return _cancelled.load(std::memory_order_relaxed);
+	}
+
+private:
+	template <typename Callable>
+	auto wrap(Callable &&callable) {
+		return [=, callable = std::forward<Callable>(callable)]() mutable {
+			{
+				// The task is destroyed before the scope may be.
+				auto local = std::move(callable);
+				if (!cancelled()) {
+					local();
+				}
+			}
+			_inflight.decrement();
+		};
+	}
+
+	void add_child(scope *child);
+	void remove_child(scope *child);
+
+	scope * const _parent = nullptr;
+	std::atomic<bool> _cancelled = false;
+	details::inflight_counter _inflight;
+
+	std::mutex _mutex;
+	std::vector<scope*> _children;
+
+};
+
+} // namespace crl
@@ -0,0 +1,136 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_semaphore.h>
+
+#ifdef CRL_USE_COMMON_SEMAPHORE
+
+#include <crl/common/crl_common_utils.h>
+#include <algorithm>
+#include <thread>
+
+namespace crl {
+namespace {
+
+constexpr auto kMaxSpin = 1000;
+constexpr auto kPollTimeout = crl::time(1);
+
+bool SpinAllowed() {
+	static const auto result = (std::thread::hardware_concurrency() > 1);
+	return result;
+}
+
+} // namespace
+
+bool semaphore::spin() {
+	if (!SpinAllowed()) {
+		return false;
+	}
+
+	// Adapt to the usual wait time, the same way glibc adaptive mutexes
+	// do: spin up to twice the average, move the average by 1/8.
+	const auto average = _spin.load(std::memory_order_relaxed);
+	const auto limit = std::min(average * 2 + 10, kMaxSpin);
+	auto spins = 0;
+	auto result = false;
+	while (spins != limit) {
+		++spins;
+		details::cpu_relax();
+		if ((_value.load(std::memory_order_relaxed) & kCountMask)
+			&& try_acquire()) {
+			result = true;
+			break;
+		}
+	}
+	_spin.store(
+		average + (spins - average) / 8,
+		std::memory_order_relaxed);
+	return result;
+}
+
+template <typename Wait>
+bool semaphore::acquire_with(Wait &&wait) {
+	if (try_acquire() || spin()) {
+		return true;
+	}
+	auto value = _value.load();
+	auto registered = false;
+	while (true) {
+		if (value & kCountMask) {
+			const auto taken = value - 1 - (registered ? kWaiter : 0);
+			if (_value.compare_exchange_weak(value, taken)) {
+				return true;
+			}
+			continue;
+		} else if (!registered
+			&& (value >> kWaiterShift) != std::uint32_t(kMaxWaiters)) {
+			if (!_value.compare_exchange_weak(value, value + kWaiter)) {
+				continue;
+			}
+			value += kWaiter;
+			registered = true;
+		}
+		if (!wait(value, registered)) {
+			break;
+		}
+		value = _value.load();
+	}
+
+	// Timed out, take the count if it appeared or just unregister.
+	const auto unregister = registered ? kWaiter : 0;
+	value = _value.load();
+	while (true) {
+		const auto taken = (value & kCountMask) ? 1 : 0;
+		if (_value.compare_exchange_weak(value, value - taken - unregister)) {
+			return (taken != 0);
+		}
+	}
+}
+
+void semaphore::acquire() {
+	acquire_with([&](std::uint32_t value, bool registered) {
+		if (registered) {
+			details::futex_wait(&_value, value);
+		} else {
+			details::futex_wait_for(&_value, value, kPollTimeout);
+		}
+		return true;
+	});
+}
+
+bool semaphore::acquire_for(crl::time timeout) {
+	const auto deadline = crl::now() + timeout;
+	return acquire_with([&](std::uint32_t value, bool registered) {
+		const auto left = deadline - crl::now();
+		if (registered || left <= kPollTimeout) {
+			return details::futex_wait_for(&_value, value, left);
+		}
+		details::futex_wait_for(&_value, value, kPollTimeout);
+		return true;
+	});
+}
+
+void semaphore::release(int count) {
+	// Check for the overflow, so that the count never gets to the
+	// waiters bits.
+	auto was = _value.load();
+	while (true) {
+		const auto add = std::min(
+			std::uint32_t(count),
+			kCountMask - (was & kCountMask));
+		if (_value.compare_exchange_weak(was, was + add)) {
+			break;
+		}
+	}
+	if (const auto waiters = int(was >> kWaiterShift)) {
+		details::futex_wake(&_value, std::min(count, waiters));
+	}
+}
+
+} // namespace crl
+
+#endif // CRL_USE_COMMON_SEMAPHORE
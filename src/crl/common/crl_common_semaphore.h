@@ -0,0 +1,70 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+
+#ifdef CRL_USE_COMMON_SEMAPHORE
+
+#include <crl/common/crl_common_futex.h>
+#include <crl/crl_time.h>
+#include <atomic>
+
+namespace crl {
+
+// Counting semaphore on a single futex word. The count is kept in the
+// low bits and the number of parked waiters in the high bits, so that
+// release() reads both in one atomic operation and makes a syscall
+// only if someone is parked.
+class semaphore {
+public:
+	semaphore() = default;
+	semaphore(const semaphore &other) = delete;
+	semaphore &operator=(const semaphore &other) = delete;
+	semaphore(semaphore &&other) = delete;
+	semaphore &operator=(semaphore &&other) = delete;
+
+	void acquire();
+	bool try_acquire() {
+		auto value = _value.load(std::memory_order_relaxed);
+		while (value & kCountMask) {
+			if (_value.compare_exchange_weak(value, value - 1)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Returns false if timeout (in milliseconds) has passed.
+	bool acquire_for(crl::time timeout);
+
+	void release(int count = 1);
+
+	// Both fit in one 32 bit word. Releases above kMaxCount are dropped,
+	// waiters above kMaxWaiters don't park and poll the count instead.
+	static constexpr auto kMaxCount = (1 << 20) - 1;
+	static constexpr auto kMaxWaiters = (1 << 12) - 1;
+
+private:
+	static constexpr auto kWaiterShift = 20;
+	static constexpr auto kCountMask = std::uint32_t(kMaxCount);
+	static constexpr auto kWaiter = std::uint32_t(1) << kWaiterShift;
+
+	bool spin();
+
+	template <typename Wait>
+	bool acquire_with(Wait &&wait);
+
+	details::futex_value _value = 0;
+	std::atomic<int> _spin = 0;
+
+};
+
+} // namespace crl
+
+#endif // CRL_USE_COMMON_SEMAPHORE
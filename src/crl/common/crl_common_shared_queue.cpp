@@ -0,0 +1,104 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_shared_queue.h>
+
+#include <crl/crl_async.h>
+
+namespace crl {
+
+shared_queue::shared_queue() = default;
+
+void shared_queue::push(BasicEntry *entry, bool shared) {
+	entry->shared = shared;
+	auto head = (BasicEntry*)nullptr;
+	while (true) {
+		if (_head.compare_exchange_weak(head, entry)) {
+			if (!head) {
+				wake_async();
+			}
+			return;
+		}
+		entry->next = head;
+	}
+}
+
+void shared_queue::wake_async() {
+	auto expected = false;
+	if (_queued.compare_exchange_strong(expected, true)) {
+		details::async_plain(ProcessCallback, static_cast<void*>(this));
+	}
+}
+
+void shared_queue::process() {
+	// Exclusive tasks run inside the frame, so that the pool treats
+	// them like the tasks of a serial queue.
+	auto frame = details::processing_frame(this);
+	if (!_pending) {
+		if (auto entry = _head.exchange(nullptr)) {
+			if (const auto next = entry->next) {
+				entry = details::reverse_list(entry, next);
+			}
+			_pending = entry;
+		}
+	}
+	while (const auto entry = _pending) {
+		if (entry->shared) {
+			_pending = entry->next;
+			++_running;
+			details::async_plain(
+				ProcessSharedCallback,
+				static_cast<void*>(entry));
+		} else if (!try_pass_barrier()) {
+			// The last running shared task will resume processing.
+			return;
+		} else {
+			_pending = entry->next;
+			entry->process(entry);
+			if (!frame.alive()) {
+				return;
+			}
+		}
+	}
+	_queued.store(false);
+
+	if (_head.load() != nullptr) {
+		wake_async();
+	}
+}
+
+bool shared_queue::try_pass_barrier() {
+	if (!_running.load()) {
+		return true;
+	} else if (_running.fetch_add(kBarrier) != 0) {
+		return false;
+	}
+	_running.fetch_sub(kBarrier);
+	return true;
+}
+
+void shared_queue::shared_finished() {
+	if (_running.fetch_sub(1) == kBarrier + 1) {
+		_running.fetch_sub(kBarrier);
+		process();
+	}
+}
+
+void shared_queue::ProcessCallback(void *that) {
+	static_cast<shared_queue*>(that)->process();
+}
+
+void shared_queue::ProcessSharedCallback(void *entry) {
+	const auto basic = static_cast<BasicEntry*>(entry);
+	basic->process(basic);
+}
+
+shared_queue::~shared_queue() {
+	details::processing_frame::destroyed(this);
+}
+
+} // namespace crl
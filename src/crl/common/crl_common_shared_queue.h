@@ -0,0 +1,97 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_list.h>
+#include <crl/common/crl_common_utils.h>
+#include <crl/common/crl_common_sync_wait.h>
+#include <atomic>
+
+namespace crl {
+
+// Serial queue that lets adjacent shared tasks run in parallel.
+// Exclusive tasks wait for all the earlier ones to finish and
+// all the later tasks wait for the exclusive ones to finish.
+class shared_queue {
+public:
+	shared_queue();
+	shared_queue(const shared_queue &other) = delete;
+	shared_queue &operator=(const shared_queue &other) = delete;
+
+	template <typename Callable>
+	void async(Callable &&callable) {
+		push(
+			details::allocate_list_entry<EntryData>(
+				std::forward<Callable>(callable)),
+			false);
+	}
+
+	template <typename Callable>
+	void async_shared(Callable &&callable) {
+		// The captures are destroyed only after shared_finished(), so
+		// that the last reference to the queue owner is held until the
+		// task doesn't access the queue any more.
+		push(details::allocate_list_entry<EntryData>([
+			this,
+			callable = std::forward<Callable>(callable)
+		]() mutable {
+			const auto guard = details::finally([&] { shared_finished(); });
+			callable();
+		}), true);
+	}
+
+	template <typename Callable>
+	void sync(Callable &&callable) {
+		semaphore waiter;
+		async([&] {
+			const auto guard = details::finally([&] { waiter.release(); });
+			callable();
+		});
+		details::sync_wait(waiter);
+	}
+
+	template <typename Callable>
+	void sync_shared(Callable &&callable) {
+		semaphore waiter;
+		async_shared([&] {
+			const auto guard = details::finally([&] { waiter.release(); });
+			callable();
+		});
+		details::sync_wait(waiter);
+	}
+
+	~shared_queue();
+
+private:
+	struct EntryData {
+		bool shared = false;
+	};
+	using BasicEntry = details::list_entry<EntryData>;
+
+	static constexpr auto kBarrier = 1 << 30;
+
+	static void ProcessCallback(void *that);
+	static void ProcessSharedCallback(void *entry);
+
+	void push(BasicEntry *entry, bool shared);
+	void wake_async();
+	void process();
+	bool try_pass_barrier();
+	void shared_finished();
+
+	std::atomic<BasicEntry*> _head = nullptr;
+	std::atomic<int> _running = 0;
+	std::atomic<bool> _queued = false;
+
+	// Accessed only by the thread that processes the queue.
+	BasicEntry *_pending = nullptr;
+
+};
+
+} // namespace crl
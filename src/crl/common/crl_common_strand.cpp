@@ -0,0 +1,184 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_strand.h>
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+
+#include <crl/crl_async.h>
+#include <algorithm>
+#include <thread>
+
+namespace crl::details {
+
+// Serially drains the strands linked into it, in the order they
+// became ready, one batch of each strand per pass.
+class strand_executor {
+public:
+	static strand_executor *Choose();
+
+	// Called before the current strand task blocks.
+	static void Blocking();
+
+	void schedule(strand *ready);
+
+private:
+	struct pass {
+		strand_executor *executor = nullptr;
+		strand *rest = nullptr;
+	};
+
+	static void ProcessCallback(void *that);
+
+	void post();
+	void process();
+	void leave();
+
+	static inline thread_local pass *CurrentPass = nullptr;
+
+	std::atomic<strand*> _head = nullptr;
+
+	// Strands left by a pass that blocked, owned by the queued pass.
+	strand *_pending = nullptr;
+	std::atomic<bool> _queued = false;
+
+};
+
+strand_executor *strand_executor::Choose() {
+	// Leaked intentionally, strands may outlive static destructors.
+	static const auto count = std::max(
+		int(std::thread::hardware_concurrency()),
+		1);
+	static const auto executors = new strand_executor[count];
+	static auto next = std::atomic<unsigned>(0);
+	return &executors[next++ % unsigned(count)];
+}
+
+void strand_executor::Blocking() {
+	const auto current = CurrentPass;
+	if (!current || !current->executor) {
+		return;
+	}
+
+	// The blocked task keeps only its own strand, the others may be
+	// the ones it waits for, so they go on in another pool task.
+	const auto executor = std::exchange(current->executor, nullptr);
+	executor->_pending = std::exchange(current->rest, nullptr);
+	if (executor->_pending) {
+		executor->post();
+	} else {
+		executor->leave();
+	}
+}
+
+void strand_executor::schedule(strand *ready) {
+	auto head = _head.load();
+	do {
+		ready->_next = head;
+	} while (!_head.compare_exchange_weak(head, ready));
+	if (head) {
+		return;
+	}
+	auto expected = false;
+	if (_queued.compare_exchange_strong(expected, true)) {
+		post();
+	}
+}
+
+void strand_executor::post() {
+	details::async_plain(ProcessCallback, static_cast<void*>(this));
+}
+
+void strand_executor::process() {
+	auto current = pass{ this, std::exchange(_pending, nullptr) };
+	if (!current.rest) {
+		auto entry = _head.exchange(nullptr);
+		while (entry) {
+			const auto next = entry->_next;
+			entry->_next = current.rest;
+			current.rest = entry;
+			entry = next;
+		}
+	}
+	const auto previous = std::exchange(CurrentPass, &current);
+	const auto guard = details::finally([&] { CurrentPass = previous; });
+	while (const auto ready = current.rest) {
+		// The strand may be destroyed or scheduled again inside.
+		current.rest = ready->_next;
+		ready->process();
+		if (!current.executor) {
+			// Blocked inside, another pass owns the executor now.
+			return;
+		}
+	}
+	leave();
+}
+
+void strand_executor::leave() {
+	_queued.store(false);
+	if (_head.load()) {
+		auto expected = false;
+		if (_queued.compare_exchange_strong(expected, true)) {
+			post();
+		}
+	}
+}
+
+void strand_executor::ProcessCallback(void *that) {
+	static_cast<strand_executor*>(that)->process();
+}
+
+void strand_blocking() {
+	strand_executor::Blocking();
+}
+
+} // namespace crl::details
+
+namespace crl {
+
+strand::strand() : _executor(details::strand_executor::Choose()) {
+}
+
+void strand::wake_async() {
+	auto expected = false;
+	if (_queued.compare_exchange_strong(expected, true)) {
+		_executor->schedule(this);
+	}
+}
+
+void strand::process() {
+	if (_list.process() == details::list::kDestroyed) {
+		return;
+	}
+	leave();
+}
+
+bool strand::try_enter() {
+	if (!_list.empty()) {
+		return false;
+	}
+	auto expected = false;
+	if (!_queued.compare_exchange_strong(expected, true)) {
+		return false;
+	} else if (!_list.empty()) {
+		leave();
+		return false;
+	}
+	return true;
+}
+
+void strand::leave() {
+	_queued.store(false);
+
+	if (!_list.empty()) {
+		wake_async();
+	}
+}
+
+} // namespace crl
+
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
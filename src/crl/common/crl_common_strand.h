@@ -0,0 +1,76 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+
+#include <crl/common/crl_common_list.h>
+#include <crl/common/crl_common_utils.h>
+#include <crl/common/crl_common_sync_wait.h>
+#include <atomic>
+
+namespace crl {
+namespace details {
+class strand_executor;
+} // namespace details
+
+// Serial queue that doesn't schedule itself on the pool. Ready strands
+// are linked into one of a few shared executors, each executor drains
+// many strands in one pool task, so idle strands cost only memory.
+// When a strand task blocks in a sync wait the executor goes on with
+// its other strands in another pool task, see details::sync_wait().
+class strand {
+public:
+	strand();
+	strand(const strand &other) = delete;
+	strand &operator=(const strand &other) = delete;
+
+	template <typename Callable>
+	void async(Callable &&callable) {
+		if (_list.push_is_first(std::forward<Callable>(callable))) {
+			wake_async();
+		}
+	}
+
+	template <typename Callable>
+	void sync(Callable &&callable) {
+		if (try_enter()) {
+			// Nothing is queued or running, invoke on this thread.
+			const auto guard = details::finally([&] { leave(); });
+			callable();
+			return;
+		}
+		semaphore waiter;
+		async([&] {
+			const auto guard = details::finally([&] { waiter.release(); });
+			callable();
+		});
+		details::sync_wait(waiter);
+	}
+
+private:
+	friend class details::strand_executor;
+
+	void wake_async();
+	void process();
+
+	bool try_enter();
+	void leave();
+
+	details::list _list;
+	strand *_next = nullptr;
+	details::strand_executor * const _executor = nullptr;
+	std::atomic<bool> _queued = false;
+
+};
+
+} // namespace crl
+
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
@@ -7,7 +7,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #pragma once
 
-#include <crl/crl_semaphore.h>
+#include <crl/common/crl_common_sync_wait.h>
 
 namespace crl {
 
@@ -18,7 +18,7 @@ inline void sync(Callable &&callable) {
 		const auto guard = details::finally([&] { waiter.release(); });
 		callable();
 	});
-	waiter.acquire();
+	details::sync_wait(waiter);
 }
 
 } // namespace crl
@@ -0,0 +1,53 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_inflight_counter.h>
+#include <crl/crl_semaphore.h>
+
+namespace crl::details {
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+
+// Lets the executor of the current strand task go on with its other
+// strands elsewhere, the task may be waiting for one of them.
+void strand_blocking();
+
+#else // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+
+inline void strand_blocking() {
+}
+
+#endif // !CRL_USE_COMMON_QUEUE && CRL_USE_DISPATCH
+
+#ifdef CRL_USE_COMMON_POOL
+
+// Waits for the semaphore of a sync call. A pool worker keeps running
+// other ready tasks meanwhile instead of holding its thread idle, so
+// nested sync calls can't exhaust the pool.
+void sync_wait(semaphore &waiter);
+
+// Same, but waits for the counter to drop to zero.
+void sync_wait(inflight_counter &counter);
+
+#else // CRL_USE_COMMON_POOL
+
+inline void sync_wait(semaphore &waiter) {
+	strand_blocking();
+	waiter.acquire();
+}
+
+inline void sync_wait(inflight_counter &counter) {
+	strand_blocking();
+	counter.wait();
+}
+
+#endif // !CRL_USE_COMMON_POOL
+
+} // namespace crl::details
@@ -0,0 +1,99 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_timer.h>
+
+#include <crl/common/crl_common_futex.h>
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace crl::details {
+namespace {
+
+class Timer {
+public:
+	void add(crl::time when, void (*callable)(void*), void *argument);
+
+private:
+	struct Entry {
+		crl::time when = 0;
+		void (*callable)(void*) = nullptr;
+		void *argument = nullptr;
+
+		friend inline bool operator<(const Entry &a, const Entry &b) {
+			return (a.when > b.when);
+		}
+	};
+
+	void run();
+
+	std::mutex _mutex;
+	std::vector<Entry> _heap;
+	futex_value _changed = 0;
+	bool _started = false;
+
+};
+
+void Timer::add(crl::time when, void (*callable)(void*), void *argument) {
+	auto lock = std::unique_lock<std::mutex>(_mutex);
+	_heap.push_back({ when, callable, argument });
+	std::push_heap(_heap.begin(), _heap.end());
+	if (!_started) {
+		_started = true;
+		std::thread([=] { run(); }).detach();
+	} else if (_heap.front().when == when) {
+		// The earliest deadline has changed, wake the thread to re-wait.
+		++_changed;
+		lock.unlock();
+		futex_wake_one(&_changed);
+	}
+}
+
+void Timer::run() {
+	auto lock = std::unique_lock<std::mutex>(_mutex);
+	while (true) {
+		const auto changed = _changed.load();
+		if (_heap.empty()) {
+			lock.unlock();
+			futex_wait(&_changed, changed);
+			lock.lock();
+			continue;
+		}
+		const auto now = crl::now();
+		const auto entry = _heap.front();
+		if (entry.when > now) {
+			lock.unlock();
+			futex_wait_for(&_changed, changed, entry.when - now);
+			lock.lock();
+			continue;
+		}
+		std::pop_heap(_heap.begin(), _heap.end());
+		_heap.pop_back();
+
+		lock.unlock();
+		entry.callable(entry.argument);
+		lock.lock();
+	}
+}
+
+Timer &GetTimer() {
+	// Leaked, the thread may still wait on it at exit.
+	static const auto result = new Timer();
+	return *result;
+}
+
+} // namespace
+
+void async_after(crl::time delay, void (*callable)(void*), void *argument) {
+	const auto when = crl::now() + std::max(delay, crl::time(0));
+	GetTimer().add(when, callable, argument);
+}
+
+} // namespace crl::details
@@ -0,0 +1,20 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/crl_time.h>
+
+namespace crl::details {
+
+// Invokes the callable on the timer thread after the delay in
+// crl::now() terms. The callable should be quick, usually it only
+// posts a task to some queue.
+void async_after(crl::time delay, void (*callable)(void*), void *argument);
+
+} // namespace crl::details
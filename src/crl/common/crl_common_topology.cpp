@@ -0,0 +1,24 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_topology.h>
+
+#ifdef CRL_USE_COMMON_TOPOLOGY
+
+namespace crl::details {
+
+std::vector<std::vector<int>> numa_nodes() {
+	return { {} };
+}
+
+bool pin_current_thread(const std::vector<int> &) {
+	return false;
+}
+
+} // namespace crl::details
+
+#endif // CRL_USE_COMMON_TOPOLOGY
@@ -0,0 +1,22 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+
+#include <vector>
+
+namespace crl::details {
+
+// CPU indices of each NUMA node, always at least one node.
+// An empty list means "any CPU".
+std::vector<std::vector<int>> numa_nodes();
+
+bool pin_current_thread(const std::vector<int> &cpus);
+
+} // namespace crl::details
@@ -19,6 +19,57 @@ using main_queue_wrapper = void(*)(void (*callable)(void*), void *argument);
 
 namespace crl::details {
 
+// Hints the CPU that we're in a spin loop.
+inline void cpu_relax() {
+#if defined __x86_64__ || defined __i386__
+	__builtin_ia32_pause();
+#elif defined __aarch64__ // __x86_64__ || __i386__
+	asm volatile("yield");
+#endif // __aarch64__
+}
+
+// Lets an object find out that one of the tasks it is running has
+// destroyed it. The frames live on the stack of the processing thread,
+// so the object itself doesn't have to store anything for that.
+class processing_frame {
+public:
+	explicit processing_frame(const void *object)
+	: _object(object)
+	, _previous(Current) {
+		Current = this;
+	}
+	processing_frame(const processing_frame &other) = delete;
+	processing_frame &operator=(const processing_frame &other) = delete;
+	~processing_frame() {
+		Current = _previous;
+	}
+
+	[[nodiscard]] bool alive() const {
+		return (_object != nullptr);
+	}
+
+	// Returns true if this thread is inside some queue processing.
+	[[nodiscard]] static bool inside() {
+		return (Current != nullptr);
+	}
+
+	// Called from the object destructor.
+	static void destroyed(const void *object) {
+		for (auto frame = Current; frame; frame = frame->_previous) {
+			if (frame->_object == object) {
+				frame->_object = nullptr;
+			}
+		}
+	}
+
+private:
+	static inline thread_local processing_frame *Current = nullptr;
+
+	const void *_object = nullptr;
+	processing_frame * const _previous = nullptr;
+
+};
+
 using true_t = char;
 struct false_t {
 	char data[2];
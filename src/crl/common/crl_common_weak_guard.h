@@ -0,0 +1,285 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/common/crl_common_on_main_guarded.h>
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace crl {
+namespace details {
+
+// Holds a guarded task body while the task is waiting in the queue.
+// Everything except reference counting happens on the guard thread.
+struct guarded_slot {
+	virtual ~guarded_slot() = default;
+
+	virtual void call() = 0;
+	virtual void clear() = 0;
+
+	void release() {
+		if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			delete this;
+		}
+	}
+
+	guarded_slot *next = nullptr;
+	std::atomic<int> references = 2; // The task and the token.
+	bool finished = false;
+};
+
+template <typename Wrap>
+struct guarded_slot_impl final : guarded_slot {
+	explicit guarded_slot_impl(Wrap &&wrap) : wrap(std::move(wrap)) {
+	}
+
+	void call() override {
+		(*wrap)();
+	}
+	void clear() override {
+		wrap.reset();
+	}
+
+	std::optional<Wrap> wrap;
+};
+
+struct alive_token {
+	static constexpr auto kMinCollectAfter = 64;
+
+	std::atomic<bool> alive = true;
+	std::atomic<int> references = 1;
+	std::atomic<guarded_slot*> slots = nullptr;
+	int finished = 0;
+	int collect_after = kMinCollectAfter;
+
+	void ref() {
+		references.fetch_add(1, std::memory_order_relaxed);
+	}
+	void unref() {
+		if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			delete this;
+		}
+	}
+
+	// Thread-safe.
+	void attach(guarded_slot *slot) {
+		auto head = slots.load(std::memory_order_relaxed);
+		do {
+			slot->next = head;
+		} while (!slots.compare_exchange_weak(
+			head,
+			slot,
+			std::memory_order_release,
+			std::memory_order_relaxed));
+	}
+
+	// Called on the guard thread after a task was invoked.
+	void finish_one() {
+		if (++finished >= collect_after) {
+			collect();
+		}
+	}
+
+	// Drops the invoked slots, keeps the pending ones attached.
+	void collect() {
+		auto kept = 0;
+		auto slot = slots.exchange(nullptr, std::memory_order_acquire);
+		while (slot) {
+			const auto next = slot->next;
+			if (slot->finished) {
+				slot->release();
+			} else {
+				attach(slot);
+				++kept;
+			}
+			slot = next;
+		}
+		finished = 0;
+		collect_after = std::max(kMinCollectAfter, kept);
+	}
+
+	// Called on the guard thread when the guarded object dies.
+	// Pending task bodies are destroyed without being invoked.
+	void purge() {
+		auto slot = slots.exchange(nullptr, std::memory_order_acquire);
+		while (slot) {
+			const auto next = slot->next;
+			if (!slot->finished) {
+				slot->finished = true;
+				slot->clear();
+			}
+			slot->release();
+			slot = next;
+		}
+	}
+
+	~alive_token() {
+		auto slot = slots.load(std::memory_order_acquire);
+		while (slot) {
+			const auto next = slot->next;
+			slot->release();
+			slot = next;
+		}
+	}
+};
+
+} // namespace details
+
+class weak_guard;
+
+// Derive from it to use raw pointers as on_main() guards.
+// The object must be destroyed on the thread that checks the guards.
+class has_weak_guard {
+public:
+	has_weak_guard() = default;
+	has_weak_guard(const has_weak_guard &) noexcept {
+	}
+	has_weak_guard &operator=(const has_weak_guard &) noexcept {
+		return *this;
+	}
+
+	~has_weak_guard() {
+		if (const auto token = _token.load(std::memory_order_acquire)) {
+			token->alive.store(false, std::memory_order_relaxed);
+			token->purge();
+			token->unref();
+		}
+	}
+
+private:
+	friend class weak_guard;
+
+	details::alive_token *token() const {
+		if (const auto result = _token.load(std::memory_order_acquire)) {
+			return result;
+		}
+		const auto created = new details::alive_token();
+		auto expected = (details::alive_token*)nullptr;
+		if (_token.compare_exchange_strong(expected, created)) {
+			return created;
+		}
+		delete created;
+		return expected;
+	}
+
+	mutable std::atomic<details::alive_token*> _token = nullptr;
+
+};
+
+class weak_guard {
+public:
+	weak_guard() = default;
+	weak_guard(const has_weak_guard *object)
+	: _token(object ? object->token() : nullptr) {
+		if (_token) {
+			_token->ref();
+		}
+	}
+	weak_guard(const has_weak_guard &object) : weak_guard(&object) {
+	}
+	weak_guard(const weak_guard &other) : _token(other._token) {
+		if (_token) {
+			_token->ref();
+		}
+	}
+	weak_guard(weak_guard &&other) noexcept
+	: _token(std::exchange(other._token, nullptr)) {
+	}
+	weak_guard &operator=(weak_guard other) noexcept {
+		std::swap(_token, other._token);
+		return *this;
+	}
+
+	// Just one relaxed load, no reference counting on the check.
+	[[nodiscard]] bool alive() const {
+		return _token && _token->alive.load(std::memory_order_relaxed);
+	}
+	explicit operator bool() const {
+		return alive();
+	}
+
+	~weak_guard() {
+		if (_token) {
+			_token->unref();
+		}
+	}
+
+private:
+	friend struct details::guard_pending_traits<weak_guard>;
+
+	details::alive_token *_token = nullptr;
+
+};
+
+template <typename T, typename Enable>
+struct guard_traits;
+
+template <>
+struct guard_traits<weak_guard, void> {
+	static weak_guard create(const weak_guard &value) {
+		return value;
+	}
+	static weak_guard create(weak_guard &&value) {
+		return std::move(value);
+	}
+	static bool check(const weak_guard &guard) {
+		return guard.alive();
+	}
+
+};
+
+template <typename T>
+struct guard_traits<
+	T*,
+	std::enable_if_t<
+		std::is_base_of_v<has_weak_guard, std::remove_cv_t<T>>>> {
+	static weak_guard create(T *value) {
+		return value;
+	}
+	static bool check(const weak_guard &guard) {
+		return guard.alive();
+	}
+
+};
+
+namespace details {
+
+template <>
+struct guard_pending_traits<weak_guard, void> {
+	static constexpr bool purgeable = true;
+
+	// Keeps the task body in a slot attached to the alive token,
+	// so that the dying guard frees it right away.
+	template <typename Wrap>
+	static auto attach(Wrap &&wrap) {
+		const auto token = wrap.get_guard()._token;
+		const auto slot = new guarded_slot_impl<std::decay_t<Wrap>>(
+			std::forward<Wrap>(wrap));
+		token->attach(slot);
+		return [=] {
+			if (!slot->finished) {
+				slot->finished = true;
+				slot->call();
+
+				// The slot keeps the token alive until it is cleared.
+				token->finish_one();
+				slot->clear();
+			}
+			slot->release();
+		};
+	}
+
+};
+
+} // namespace details
+} // namespace crl
@@ -8,8 +8,23 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include <crl/crl_semaphore.h>
+#include <crl/crl_latch.h>
+#include <crl/crl_barrier.h>
+#include <crl/crl_event.h>
 #include <crl/crl_async.h>
 #include <crl/crl_queue.h>
+#include <crl/crl_strand.h>
+#include <crl/crl_concurrent_queue.h>
+#include <crl/crl_coalescing_queue.h>
+#include <crl/crl_keyed_executor.h>
+#include <crl/crl_actor.h>
+#include <crl/crl_group.h>
+#include <crl/crl_scope.h>
+#include <crl/crl_debounce.h>
 #include <crl/crl_on_main.h>
+#include <crl/crl_main_loop.h>
+#include <crl/crl_io.h>
 #include <crl/crl_object_on_queue.h>
+#include <crl/crl_shared_queue.h>
+#include <crl/crl_shared_object_on_queue.h>
 #include <crl/crl_time.h>
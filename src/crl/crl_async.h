@@ -13,8 +13,26 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include <crl/winapi/crl_winapi_async.h>
 #elif defined CRL_USE_DISPATCH // CRL_USE_WINAPI
 #include <crl/dispatch/crl_dispatch_async.h>
-#elif defined CRL_USE_QT // CRL_USE_DISPATCH
+#elif defined CRL_USE_COMMON_POOL // CRL_USE_DISPATCH
+#include <crl/common/crl_common_async.h>
+#elif defined CRL_USE_QT // CRL_USE_COMMON_POOL
 #include <crl/qt/crl_qt_async.h>
 #else // CRL_USE_QT
 #error "Configuration is not supported."
-#endif // !CRL_USE_WINAPI && !CRL_USE_DISPATCH && !CRL_USE_QT
+#endif // !CRL_USE_WINAPI && !CRL_USE_DISPATCH && !CRL_USE_COMMON_POOL && !CRL_USE_QT
+
+#ifndef CRL_USE_COMMON_POOL
+
+#include <utility>
+
+namespace crl {
+
+// There is no separate blocking pool in this configuration.
+template <typename Callable>
+inline void async_blocking(Callable &&callable) {
+	async(std::forward<Callable>(callable));
+}
+
+} // namespace crl
+
+#endif // !CRL_USE_COMMON_POOL
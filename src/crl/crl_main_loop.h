@@ -0,0 +1,14 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+
+#ifdef CRL_USE_LINUX_MAIN_LOOP
+#include <crl/linux/crl_linux_main_loop.h>
+#endif // CRL_USE_LINUX_MAIN_LOOP
@@ -8,9 +8,13 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include <crl/common/crl_common_config.h>
-#include <crl/crl_queue.h>
+#include <crl/crl_strand.h>
 #include <crl/crl_on_main.h>
+#include <crl/common/crl_common_list.h>
 #include <memory>
+#include <optional>
+#include <future>
+#include <utility>
 
 #ifdef CRL_ENABLE_RPL_INTEGRATION
 #include <rpl/producer.h>
@@ -34,6 +38,12 @@ public:
 	template <typename Method>
 	void with(Method &&method) const;
 
+	template <typename Method>
+	auto with_sync(Method &&method);
+
+	template <typename Method>
+	auto with_sync(Method &&method) const;
+
 	template <
 		typename Value,
 		typename = std::enable_if_t<!std::is_reference_v<Value>>>
@@ -45,11 +55,28 @@ private:
 	template <typename Callable>
 	void async(Callable &&callable) const;
 
+	template <
+		typename Callable,
+		typename Result = std::decay_t<decltype(
+			std::declval<Callable>()())>>
+	Result sync(Callable &&callable) const;
+
 	Type &value();
 	const Type &value() const;
 
 	std::aligned_storage_t<sizeof(Type), alignof(Type)> _storage;
-	mutable crl::queue _queue;
+
+	// Objects don't schedule themselves on the pool one by one,
+	// they are multiplexed on a few shared executors instead.
+	mutable crl::strand _strand;
+
+#if defined CRL_USE_COMMON_LIST || defined CRL_USE_WINAPI_LIST
+	// Calls are collected here and drained by one queue entry
+	// that holds a single strong reference for the whole batch.
+	void drain() const;
+
+	mutable details::list _batch;
+#endif // CRL_USE_COMMON_LIST || CRL_USE_WINAPI_LIST
 
 };
 
@@ -126,6 +153,34 @@ public:
 	template <typename Method>
 	void with(Method &&method) const;
 
+	// Blocks until the method is invoked and returns its result.
+	// Runs on the calling thread if the queue is idle.
+	// Don't call it from the object queue itself.
+	template <
+		typename Method,
+		typename Result = std::decay_t<decltype(
+			std::declval<Method>()(std::declval<Type&>()))>>
+	Result with_sync(Method &&method);
+
+	template <
+		typename Method,
+		typename Result = std::decay_t<decltype(
+			std::declval<Method>()(std::declval<const Type&>()))>>
+	Result with_sync(Method &&method) const;
+
+	// Enqueues the method and returns a future for its result.
+	template <
+		typename Method,
+		typename Result = std::decay_t<decltype(
+			std::declval<Method>()(std::declval<Type&>()))>>
+	std::future<Result> with_value(Method &&method);
+
+	template <
+		typename Method,
+		typename Result = std::decay_t<decltype(
+			std::declval<Method>()(std::declval<const Type&>()))>>
+	std::future<Result> with_value(Method &&method) const;
+
 	template <
 		typename Value,
 		typename = std::enable_if_t<!std::is_reference_v<Value>>>
@@ -153,6 +208,10 @@ public:
 
 private:
 	using Data = details::object_on_queue_data<Type>;
+
+	template <typename Result, typename Pointer, typename Method>
+	static std::future<Result> WithValue(Pointer data, Method &&method);
+
 	std::shared_ptr<Data> _data;
 
 };
@@ -162,13 +221,29 @@ namespace details {
 template <typename Type>
 template <typename Callable>
 void object_on_queue_data<Type>::async(Callable &&callable) const {
-	_queue.async([
+#if defined CRL_USE_COMMON_LIST || defined CRL_USE_WINAPI_LIST
+	if (_batch.push_is_first(std::forward<Callable>(callable))) {
+		_strand.async([that = this->shared_from_this()] {
+			that->drain();
+		});
+	}
+#else // CRL_USE_COMMON_LIST || CRL_USE_WINAPI_LIST
+	_strand.async([
 		that = this->shared_from_this(),
 		what = std::forward<Callable>(callable)
 	]() mutable {
 		std::move(what)();
 	});
+#endif // !CRL_USE_COMMON_LIST && !CRL_USE_WINAPI_LIST
+}
+
+#if defined CRL_USE_COMMON_LIST || defined CRL_USE_WINAPI_LIST
+template <typename Type>
+void object_on_queue_data<Type>::drain() const {
+	// Calls made while draining start a new batch behind this one.
+	_batch.process();
 }
+#endif // CRL_USE_COMMON_LIST || CRL_USE_WINAPI_LIST
 
 template <typename Type>
 Type &object_on_queue_data<Type>::value() {
@@ -210,10 +285,42 @@ void object_on_queue_data<Type>::with(Method &&method) const {
 	});
 }
 
+template <typename Type>
+template <typename Callable, typename Result>
+Result object_on_queue_data<Type>::sync(Callable &&callable) const {
+	const auto invoke = [&] {
+#if defined CRL_USE_COMMON_LIST || defined CRL_USE_WINAPI_LIST
+		// We're on the queue, so pending calls can run right here.
+		drain();
+#endif // CRL_USE_COMMON_LIST || CRL_USE_WINAPI_LIST
+		return callable();
+	};
+	if constexpr (std::is_void_v<Result>) {
+		_strand.sync(invoke);
+	} else {
+		auto result = std::optional<Result>();
+		_strand.sync([&] { result.emplace(invoke()); });
+		return std::move(*result);
+	}
+}
+
+template <typename Type>
+template <typename Method>
+auto object_on_queue_data<Type>::with_sync(Method &&method) {
+	return sync([&] { return method(value()); });
+}
+
+template <typename Type>
+template <typename Method>
+auto object_on_queue_data<Type>::with_sync(Method &&method) const {
+	return sync([&] { return method(value()); });
+}
+
 template <typename Type>
 template <typename Value, typename>
 void object_on_queue_data<Type>::destroy(Value &&value) const {
-	_queue.async([moved = std::move(value)]{});
+	// Goes through the batch as well to keep the order with other calls.
+	async([moved = std::move(value)]{});
 }
 
 template <typename Type>
@@ -232,8 +339,15 @@ template <typename Type>
 template <typename Method>
 void weak_on_queue<Type>::with(Method &&method) const {
 	if (auto strong = _weak.lock()) {
-		strong->with(std::move(method));
-		strong->destroy(std::move(strong));
+		// The strong reference travels in the same entry,
+		// so it is released on the queue after the method.
+		const auto raw = strong.get();
+		raw->with([
+			strong = std::move(strong),
+			method = std::forward<Method>(method)
+		](auto &value) mutable {
+			std::move(method)(value);
+		});
 	}
 }
 
@@ -241,8 +355,8 @@ template <typename Type>
 template <typename Value, typename>
 void weak_on_queue<Type>::destroy(Value &&value) const {
 	if (auto strong = _weak.lock()) {
-		strong->destroy(std::move(value));
-		strong->destroy(std::move(strong));
+		const auto raw = strong.get();
+		raw->destroy(std::make_pair(std::move(strong), std::move(value)));
 	} else {
 		[[maybe_unused]] const auto moved = std::move(value);
 	}
@@ -339,6 +453,55 @@ void object_on_queue<Type>::with(Method &&method) const {
 	data->with(std::forward<Method>(method));
 }
 
+template <typename Type>
+template <typename Method, typename Result>
+Result object_on_queue<Type>::with_sync(Method &&method) {
+	return _data->with_sync(std::forward<Method>(method));
+}
+
+template <typename Type>
+template <typename Method, typename Result>
+Result object_on_queue<Type>::with_sync(Method &&method) const {
+	const auto data = static_cast<const Data*>(_data.get());
+	return data->with_sync(std::forward<Method>(method));
+}
+
+template <typename Type>
+template <typename Result, typename Pointer, typename Method>
+std::future<Result> object_on_queue<Type>::WithValue(
+		Pointer data,
+		Method &&method) {
+	auto promise = std::promise<Result>();
+	auto result = promise.get_future();
+	data->with([
+		promise = std::move(promise),
+		method = std::forward<Method>(method)
+	](auto &value) mutable {
+		if constexpr (std::is_void_v<Result>) {
+			std::move(method)(value);
+			promise.set_value();
+		} else {
+			promise.set_value(std::move(method)(value));
+		}
+	});
+	return result;
+}
+
+template <typename Type>
+template <typename Method, typename Result>
+std::future<Result> object_on_queue<Type>::with_value(Method &&method) {
+	return WithValue<Result>(_data.get(), std::forward<Method>(method));
+}
+
+template <typename Type>
+template <typename Method, typename Result>
+std::future<Result> object_on_queue<Type>::with_value(
+		Method &&method) const {
+	return WithValue<Result>(
+		static_cast<const Data*>(_data.get()),
+		std::forward<Method>(method));
+}
+
 template <typename Type>
 template <typename Value, typename>
 void object_on_queue<Type>::destroy(Value &&value) const {
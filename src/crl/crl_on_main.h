@@ -21,6 +21,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include <crl/common/crl_common_on_main_guarded.h>
 #include <crl/common/crl_common_guards.h>
+#include <crl/common/crl_common_weak_guard.h>
 #include <crl/qt/crl_qt_guards.h>
 
 #ifdef CRL_ENABLE_RPL_INTEGRATION
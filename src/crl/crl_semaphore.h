@@ -13,7 +13,9 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include <crl/winapi/crl_winapi_semaphore.h>
 #elif defined CRL_USE_DISPATCH // CRL_USE_WINAPI
 #include <crl/dispatch/crl_dispatch_semaphore.h>
-#elif defined CRL_USE_QT // CRL_USE_DISPATCH
+#elif defined CRL_USE_COMMON_SEMAPHORE // CRL_USE_DISPATCH
+#include <crl/common/crl_common_semaphore.h>
+#elif defined CRL_USE_QT // CRL_USE_COMMON_SEMAPHORE
 #include <crl/qt/crl_qt_semaphore.h>
 #else // CRL_USE_QT
 #error "Configuration is not supported."
@@ -0,0 +1,268 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+#include <crl/crl_shared_queue.h>
+#include <crl/common/crl_common_utils.h>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+namespace crl {
+namespace details {
+
+template <typename Type>
+class shared_object_on_queue_data final
+	: public std::enable_shared_from_this<
+		shared_object_on_queue_data<Type>> {
+public:
+	template <typename ...Args>
+	void construct(Args &&...args);
+
+	template <typename Method>
+	void with(Method &&method);
+
+	template <typename Method>
+	void with(Method &&method) const;
+
+	template <
+		typename Value,
+		typename = std::enable_if_t<!std::is_reference_v<Value>>>
+	void destroy(Value &&value) const;
+
+	~shared_object_on_queue_data();
+
+private:
+	Type &value();
+	const Type &value() const;
+
+	std::aligned_storage_t<sizeof(Type), alignof(Type)> _storage;
+	mutable shared_queue _queue;
+
+};
+
+} // namespace details
+
+// Like weak_on_queue, methods of weak_shared_on_queue<const Type>
+// run in parallel with other const methods.
+template <typename Type>
+class weak_shared_on_queue final {
+	using data = details::shared_object_on_queue_data<
+		std::remove_const_t<Type>>;
+	using my_data = std::conditional_t<
+		std::is_const_v<Type>,
+		const data,
+		data>;
+
+public:
+	weak_shared_on_queue() = default;
+	weak_shared_on_queue(const std::shared_ptr<data> &strong);
+	weak_shared_on_queue(const weak_shared_on_queue &other) = default;
+	weak_shared_on_queue(weak_shared_on_queue &&other) = default;
+	weak_shared_on_queue &operator=(
+		const weak_shared_on_queue &other) = default;
+	weak_shared_on_queue &operator=(weak_shared_on_queue &&other) = default;
+
+	template <typename Method>
+	void with(Method &&method) const;
+
+	template <
+		typename Value,
+		typename = std::enable_if_t<!std::is_reference_v<Value>>>
+	void destroy(Value &&value) const;
+
+private:
+	std::weak_ptr<my_data> _weak;
+
+};
+
+// Like object_on_queue, but const methods run in parallel
+// with each other, while non-const methods run exclusively.
+template <typename Type>
+class shared_object_on_queue final {
+public:
+	template <typename ...Args>
+	shared_object_on_queue(Args &&...args);
+
+	shared_object_on_queue(const shared_object_on_queue &other) = delete;
+	shared_object_on_queue &operator=(
+		const shared_object_on_queue &other) = delete;
+
+	template <typename Method>
+	void with(Method &&method);
+
+	template <typename Method>
+	void with(Method &&method) const;
+
+	template <
+		typename Value,
+		typename = std::enable_if_t<!std::is_reference_v<Value>>>
+	void destroy(Value &&value) const;
+
+	weak_shared_on_queue<Type> weak();
+	weak_shared_on_queue<const Type> weak() const;
+
+	~shared_object_on_queue();
+
+private:
+	using Data = details::shared_object_on_queue_data<Type>;
+	std::shared_ptr<Data> _data;
+
+};
+
+namespace details {
+
+template <typename Type>
+Type &shared_object_on_queue_data<Type>::value() {
+	return *reinterpret_cast<Type*>(&_storage);
+}
+
+template <typename Type>
+const Type &shared_object_on_queue_data<Type>::value() const {
+	return *reinterpret_cast<const Type*>(&_storage);
+}
+
+template <typename Type>
+template <typename ...Args>
+void shared_object_on_queue_data<Type>::construct(Args &&...args) {
+	_queue.async([arguments = std::make_tuple(
+		&_storage,
+		std::forward<Args>(args)...
+	)]() mutable {
+		const auto create = [](void *storage, Args &&...args) {
+			new (storage) Type(std::forward<Args>(args)...);
+		};
+		std::apply(create, std::move(arguments));
+	});
+}
+
+template <typename Type>
+template <typename Method>
+void shared_object_on_queue_data<Type>::with(Method &&method) {
+	_queue.async([
+		that = this->shared_from_this(),
+		method = std::forward<Method>(method)
+	]() mutable {
+		std::move(method)(that->value());
+	});
+}
+
+template <typename Type>
+template <typename Method>
+void shared_object_on_queue_data<Type>::with(Method &&method) const {
+	_queue.async_shared([
+		that = this->shared_from_this(),
+		method = std::forward<Method>(method)
+	]() mutable {
+		std::move(method)(that->value());
+	});
+}
+
+template <typename Type>
+template <typename Value, typename>
+void shared_object_on_queue_data<Type>::destroy(Value &&value) const {
+	_queue.async([moved = std::move(value)]{});
+}
+
+template <typename Type>
+shared_object_on_queue_data<Type>::~shared_object_on_queue_data() {
+	value().~Type();
+}
+
+} // namespace details
+
+template <typename Type>
+weak_shared_on_queue<Type>::weak_shared_on_queue(
+	const std::shared_ptr<data> &strong)
+: _weak(strong) {
+}
+
+template <typename Type>
+template <typename Method>
+void weak_shared_on_queue<Type>::with(Method &&method) const {
+	if (auto strong = _weak.lock()) {
+		// The strong reference travels in the same entry,
+		// so it is released on the queue after the method.
+		const auto raw = strong.get();
+		raw->with([
+			strong = std::move(strong),
+			method = std::forward<Method>(method)
+		](auto &value) mutable {
+			std::move(method)(value);
+		});
+	}
+}
+
+template <typename Type>
+template <typename Value, typename>
+void weak_shared_on_queue<Type>::destroy(Value &&value) const {
+	if (auto strong = _weak.lock()) {
+		const auto raw = strong.get();
+		raw->destroy(std::make_pair(std::move(strong), std::move(value)));
+	} else {
+		[[maybe_unused]] const auto moved = std::move(value);
+	}
+}
+
+template <typename Type>
+template <typename ...Args>
+shared_object_on_queue<Type>::shared_object_on_queue(Args &&...args)
+: _data(std::make_shared<Data>()) {
+	constexpr auto plain_construct = std::is_constructible_v<
+		Type,
+		Args...>;
+	constexpr auto with_weak_construct = std::is_constructible_v<
+		Type,
+		weak_shared_on_queue<Type>,
+		Args...>;
+	if constexpr (plain_construct) {
+		_data->construct(std::forward<Args>(args)...);
+	} else if constexpr (with_weak_construct) {
+		_data->construct(weak(), std::forward<Args>(args)...);
+	} else {
+		static_assert(false_t(args...), "Could not find a constructor.");
+	}
+}
+
+template <typename Type>
+template <typename Method>
+void shared_object_on_queue<Type>::with(Method &&method) {
+	_data->with(std::forward<Method>(method));
+}
+
+template <typename Type>
+template <typename Method>
+void shared_object_on_queue<Type>::with(Method &&method) const {
+	const auto data = static_cast<const Data*>(_data.get());
+	data->with(std::forward<Method>(method));
+}
+
+template <typename Type>
+template <typename Value, typename>
+void shared_object_on_queue<Type>::destroy(Value &&value) const {
+	_data->destroy(std::move(value));
+}
+
+template <typename Type>
+auto shared_object_on_queue<Type>::weak() -> weak_shared_on_queue<Type> {
+	return { _data };
+}
+
+template <typename Type>
+auto shared_object_on_queue<Type>::weak() const
+-> weak_shared_on_queue<const Type> {
+	return { _data };
+}
+
+template <typename Type>
+shared_object_on_queue<Type>::~shared_object_on_queue() {
+	_data->destroy(std::move(_data));
+}
+
+} // namespace crl
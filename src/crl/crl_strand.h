@@ -0,0 +1,27 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+
+#if defined CRL_USE_WINAPI || defined CRL_USE_COMMON_QUEUE
+#include <crl/common/crl_common_strand.h>
+#elif defined CRL_USE_DISPATCH // CRL_USE_WINAPI
+#include <crl/crl_queue.h>
+
+namespace crl {
+
+// GCD already multiplexes its queues on a shared pool.
+using strand = queue;
+
+} // namespace crl
+#elif defined CRL_USE_QT // CRL_USE_DISPATCH
+#include <crl/common/crl_common_strand.h>
+#else // CRL_USE_QT
+#error "Configuration is not supported."
+#endif // !CRL_USE_WINAPI && !CRL_USE_DISPATCH && !CRL_USE_QT
@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #ifdef CRL_USE_DISPATCH
 
 #include <dispatch/dispatch.h>
+#include <algorithm>
 #include <exception>
 
 namespace crl {
@@ -39,8 +40,22 @@ void semaphore::acquire() {
 	dispatch_semaphore_wait(Unwrap(_handle.get()), DISPATCH_TIME_FOREVER);
 }
 
-void semaphore::release() {
-	dispatch_semaphore_signal(Unwrap(_handle.get()));
+bool semaphore::try_acquire() {
+	return !dispatch_semaphore_wait(Unwrap(_handle.get()), DISPATCH_TIME_NOW);
+}
+
+bool semaphore::acquire_for(crl::time timeout) {
+	const auto when = dispatch_time(
+		DISPATCH_TIME_NOW,
+		std::max(timeout, crl::time(0)) * NSEC_PER_MSEC);
+	return !dispatch_semaphore_wait(Unwrap(_handle.get()), when);
+}
+
+void semaphore::release(int count) {
+	// There is no batch signal, each one wakes at most one waiter.
+	for (auto i = 0; i != count; ++i) {
+		dispatch_semaphore_signal(Unwrap(_handle.get()));
+	}
 }
 
 } // namespace crl
@@ -11,6 +11,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #ifdef CRL_USE_DISPATCH
 
+#include <crl/crl_time.h>
 #include <memory>
 
 namespace crl {
@@ -30,7 +31,12 @@ public:
 	}
 
 	void acquire();
-	void release();
+	bool try_acquire();
+
+	// Returns false if timeout (in milliseconds) has passed.
+	bool acquire_for(crl::time timeout);
+
+	void release(int count = 1);
 
 private:
 	// Hide dispatch_semaphore_t
@@ -0,0 +1,71 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_futex.h>
+
+#ifdef CRL_USE_LINUX_FUTEX
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <climits>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+
+namespace crl::details {
+namespace {
+
+long Futex(
+		futex_value *value,
+		int operation,
+		std::uint32_t argument,
+		const timespec *timeout = nullptr) {
+	return syscall(
+		SYS_futex,
+		reinterpret_cast<std::uint32_t*>(value),
+		operation | FUTEX_PRIVATE_FLAG,
+		argument,
+		timeout,
+		nullptr,
+		0);
+}
+
+} // namespace
+
+void futex_wait(futex_value *value, std::uint32_t expected) {
+	Futex(value, FUTEX_WAIT, expected);
+}
+
+bool futex_wait_for(
+		futex_value *value,
+		std::uint32_t expected,
+		crl::time timeout) {
+	if (timeout <= 0) {
+		return (value->load() != expected);
+	}
+	timespec relative;
+	relative.tv_sec = timeout / 1000;
+	relative.tv_nsec = (timeout % 1000) * 1000000;
+	const auto result = Futex(value, FUTEX_WAIT, expected, &relative);
+	return (result == 0) || (errno != ETIMEDOUT);
+}
+
+void futex_wake_one(futex_value *value) {
+	Futex(value, FUTEX_WAKE, 1);
+}
+
+void futex_wake_all(futex_value *value) {
+	Futex(value, FUTEX_WAKE, INT_MAX);
+}
+
+void futex_wake(futex_value *value, int count) {
+	Futex(value, FUTEX_WAKE, std::uint32_t(count));
+}
+
+} // namespace crl::details
+
+#endif // CRL_USE_LINUX_FUTEX
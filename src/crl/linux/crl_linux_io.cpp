@@ -0,0 +1,273 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_io.h>
+
+#ifdef CRL_USE_LINUX_IO
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace crl::details {
+namespace {
+
+constexpr auto kEntries = 1024U;
+constexpr auto kMaxSize = std::size_t(0x7FFFF000);
+
+// IORING_OP_READ, WRITE and OPENAT need Linux 5.6, the same version
+// reports IORING_FEAT_RW_CUR_POS, so that is checked instead of a probe.
+constexpr auto kRequiredFeatures = IORING_FEAT_NODROP
+	| IORING_FEAT_RW_CUR_POS;
+
+int Setup(unsigned entries, io_uring_params *params) {
+	return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int Enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+	return int(syscall(
+		__NR_io_uring_enter,
+		fd,
+		submit,
+		wait,
+		flags,
+		nullptr,
+		0));
+}
+
+template <typename Type>
+Type *Field(void *base, std::uint32_t offset) {
+	return reinterpret_cast<Type*>(static_cast<char*>(base) + offset);
+}
+
+// One submission ring shared by all threads and one thread that reaps
+// the completions and passes them to the request callbacks.
+class Ring {
+public:
+	// Returns nullptr if io_uring is not available.
+	static Ring *Instance();
+
+	~Ring();
+
+	// Returns false if the ring is full or the submission failed.
+	bool submit(io_request *request);
+
+private:
+	Ring() = default;
+
+	bool init();
+	void fill(io_uring_sqe *entry, io_request *request);
+	void run();
+
+	int _fd = -1;
+
+	void *_sq = MAP_FAILED;
+	std::size_t _sqSize = 0;
+	void *_cq = MAP_FAILED;
+	std::size_t _cqSize = 0;
+	io_uring_sqe *_entries = static_cast<io_uring_sqe*>(MAP_FAILED);
+	std::size_t _entriesSize = 0;
+
+	unsigned *_sqHead = nullptr;
+	unsigned *_sqTail = nullptr;
+	unsigned _sqMask = 0;
+	unsigned *_sqArray = nullptr;
+	unsigned _sqCount = 0;
+
+	unsigned *_cqHead = nullptr;
+	unsigned *_cqTail = nullptr;
+	unsigned _cqMask = 0;
+	io_uring_cqe *_cqes = nullptr;
+	unsigned _cqCount = 0;
+
+	std::mutex _mutex;
+	std::atomic<unsigned> _inflight = 0;
+
+};
+
+Ring *Ring::Instance() {
+	// Leaked intentionally, the reaping thread never stops.
+	static const auto result = [] {
+		auto ring = new Ring();
+		if (!ring->init()) {
+			delete ring;
+			return (Ring*)nullptr;
+		}
+		std::thread([=] { ring->run(); }).detach();
+		return ring;
+	}();
+	return result;
+}
+
+Ring::~Ring() {
+	if (_entries != MAP_FAILED) {
+		munmap(_entries, _entriesSize);
+	}
+	if (_cq != MAP_FAILED && _cq != _sq) {
+		munmap(_cq, _cqSize);
+	}
+	if (_sq != MAP_FAILED) {
+		munmap(_sq, _sqSize);
+	}
+	if (_fd >= 0) {
+		close(_fd);
+	}
+}
+
+bool Ring::init() {
+	auto params = io_uring_params();
+	_fd = Setup(kEntries, &params);
+	if (_fd < 0
+		|| (params.features & kRequiredFeatures) != kRequiredFeatures) {
+		return false;
+	}
+	_sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	_cqSize = params.cq_off.cqes
+		+ params.cq_entries * sizeof(io_uring_cqe);
+	const auto single = (params.features & IORING_FEAT_SINGLE_MMAP);
+	if (single) {
+		_sqSize = _cqSize = std::max(_sqSize, _cqSize);
+	}
+	const auto map = [&](std::size_t size, off_t offset) {
+		return mmap(
+			nullptr,
+			size,
+			PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE,
+			_fd,
+			offset);
+	};
+	_sq = map(_sqSize, IORING_OFF_SQ_RING);
+	if (_sq == MAP_FAILED) {
+		return false;
+	}
+	_cq = single ? _sq : map(_cqSize, IORING_OFF_CQ_RING);
+	if (_cq == MAP_FAILED) {
+		return false;
+	}
+	_entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+	_entries = static_cast<io_uring_sqe*>(
+		map(_entriesSize, IORING_OFF_SQES));
+	if (_entries == MAP_FAILED) {
+		return false;
+	}
+
+	_sqHead = Field<unsigned>(_sq, params.sq_off.head);
+	_sqTail = Field<unsigned>(_sq, params.sq_off.tail);
+	_sqMask = *Field<unsigned>(_sq, params.sq_off.ring_mask);
+	_sqArray = Field<unsigned>(_sq, params.sq_off.array);
+	_sqCount = params.sq_entries;
+
+	_cqHead = Field<unsigned>(_cq, params.cq_off.head);
+	_cqTail = Field<unsigned>(_cq, params.cq_off.tail);
+	_cqMask = *Field<unsigned>(_cq, params.cq_off.ring_mask);
+	_cqes = Field<io_uring_cqe>(_cq, params.cq_off.cqes);
+	_cqCount = params.cq_entries;
+	return true;
+}
+
+void Ring::fill(io_uring_sqe *entry, io_request *request) {
+	std::memset(entry, 0, sizeof(io_uring_sqe));
+	entry->fd = request->fd;
+	entry->user_data = reinterpret_cast<std::uintptr_t>(request);
+	switch (request->operation) {
+	case io_operation::read:
+	case io_operation::write:
+		entry->opcode = (request->operation == io_operation::read)
+			? IORING_OP_READ
+			: IORING_OP_WRITE;
+		entry->off = request->offset;
+		entry->addr = reinterpret_cast<std::uintptr_t>(request->buffer);
+		entry->len = unsigned(std::min(request->size, kMaxSize));
+		break;
+	case io_operation::fsync:
+		entry->opcode = IORING_OP_FSYNC;
+		break;
+	case io_operation::openat:
+		entry->opcode = IORING_OP_OPENAT;
+		entry->addr = reinterpret_cast<std::uintptr_t>(
+			request->path.c_str());
+		entry->len = unsigned(request->mode);
+		entry->open_flags = unsigned(request->flags);
+		break;
+	}
+}
+
+bool Ring::submit(io_request *request) {
+	// Keep the completion ring from overflowing.
+	if (_inflight.fetch_add(1) >= _cqCount) {
+		--_inflight;
+		return false;
+	}
+	const auto lock = std::lock_guard<std::mutex>(_mutex);
+	const auto tail = *_sqTail;
+	const auto head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+	if (tail - head >= _sqCount) {
+		--_inflight;
+		return false;
+	}
+	const auto index = tail & _sqMask;
+	fill(&_entries[index], request);
+	_sqArray[index] = index;
+	__atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+	while (Enter(_fd, 1, 0, 0) < 0) {
+		if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Take the entry back if the kernel didn't consume it,
+		// so that it is performed on the blocking pool instead.
+		if (__atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) != tail + 1) {
+			__atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+			--_inflight;
+			return false;
+		}
+		break;
+	}
+	return true;
+}
+
+void Ring::run() {
+	while (true) {
+		auto head = *_cqHead;
+		const auto tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			Enter(_fd, 0, 1, IORING_ENTER_GETEVENTS);
+			continue;
+		}
+		while (head != tail) {
+			const auto &completion = _cqes[head & _cqMask];
+			const auto request = reinterpret_cast<io_request*>(
+				std::uintptr_t(completion.user_data));
+			const auto result = completion.res;
+			__atomic_store_n(_cqHead, ++head, __ATOMIC_RELEASE);
+			--_inflight;
+			request->complete(request, result);
+		}
+	}
+}
+
+} // namespace
+
+void io_submit(io_request *request) {
+	const auto ring = Ring::Instance();
+	if (!ring || !ring->submit(request)) {
+		io_submit_blocking(request);
+	}
+}
+
+} // namespace crl::details
+
+#endif // CRL_USE_LINUX_IO
@@ -0,0 +1,237 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/linux/crl_linux_main_loop.h>
+
+#ifdef CRL_USE_LINUX_MAIN_LOOP
+
+#include <crl/crl_on_main.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace crl {
+namespace {
+
+constexpr auto kMaxEvents = 64;
+
+struct Request {
+	void (*callable)(void*) = nullptr;
+	void *argument = nullptr;
+};
+
+struct Loop {
+	int epoll = -1;
+	int wakeup = -1;
+
+	std::mutex mutex;
+	std::vector<Request> requests;
+
+	std::atomic<bool> quit = false;
+	std::atomic<int> code = 0;
+
+	std::map<
+		std::pair<crl::time, main_loop_timer>,
+		std::function<void()>> timers;
+	std::unordered_map<main_loop_timer, crl::time> timerTimes;
+	main_loop_timer timerId = 0;
+
+	std::unordered_map<int, std::function<void(std::uint32_t)>> watched;
+};
+
+// Leaked, the main queue may outlive static destructors.
+Loop *Instance = nullptr;
+
+Loop &Get() {
+	if (!Instance) {
+		std::terminate();
+	}
+	return *Instance;
+}
+
+void Signal(Loop &loop) {
+	const auto value = std::uint64_t(1);
+	while (write(loop.wakeup, &value, sizeof(value)) < 0
+		&& errno == EINTR) {
+	}
+}
+
+void Processor(void (*callable)(void*), void *argument) {
+	auto &loop = Get();
+	auto wake = false;
+	{
+		const auto lock = std::lock_guard<std::mutex>(loop.mutex);
+		loop.requests.push_back({ callable, argument });
+		wake = (loop.requests.size() == 1);
+	}
+	if (wake) {
+		Signal(loop);
+	}
+}
+
+void ProcessRequests(Loop &loop) {
+	auto value = std::uint64_t();
+	while (read(loop.wakeup, &value, sizeof(value)) < 0 && errno == EINTR) {
+	}
+	auto requests = std::vector<Request>();
+	{
+		const auto lock = std::lock_guard<std::mutex>(loop.mutex);
+		std::swap(requests, loop.requests);
+	}
+	for (const auto &request : requests) {
+		request.callable(request.argument);
+	}
+}
+
+int NextTimeout(const Loop &loop) {
+	if (loop.timers.empty()) {
+		return -1;
+	}
+	const auto left = loop.timers.begin()->first.first - crl::now();
+	return int(std::clamp(left, crl::time(0), crl::time(INT_MAX)));
+}
+
+void ProcessTimers(Loop &loop) {
+	const auto now = crl::now();
+	while (!loop.timers.empty() && loop.timers.begin()->first.first <= now) {
+		const auto i = loop.timers.begin();
+		auto callback = std::move(i->second);
+		loop.timerTimes.erase(i->first.second);
+		loop.timers.erase(i);
+		callback();
+	}
+}
+
+void ProcessWatched(Loop &loop, int fd, std::uint32_t events) {
+	const auto i = loop.watched.find(fd);
+	if (i == end(loop.watched)) {
+		return;
+	}
+
+	// The callback may unwatch or rewatch its own descriptor,
+	// so it is moved out for the call and put back only if the
+	// descriptor is still watched without a new callback.
+	auto callback = std::exchange(i->second, nullptr);
+	callback(events);
+	const auto j = loop.watched.find(fd);
+	if (j != end(loop.watched) && !j->second) {
+		j->second = std::move(callback);
+	}
+}
+
+} // namespace
+
+void init_main_loop() {
+	if (Instance) {
+		std::terminate();
+	}
+	const auto loop = new Loop();
+	loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+	loop->wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (loop->epoll < 0 || loop->wakeup < 0) {
+		std::terminate();
+	}
+	auto event = epoll_event();
+	event.events = EPOLLIN;
+	event.data.fd = loop->wakeup;
+	if (epoll_ctl(loop->epoll, EPOLL_CTL_ADD, loop->wakeup, &event) < 0) {
+		std::terminate();
+	}
+	Instance = loop;
+	init_main_queue(Processor);
+}
+
+int run_main_loop() {
+	auto &loop = Get();
+	epoll_event events[kMaxEvents];
+	while (!loop.quit.load()) {
+		const auto count = epoll_wait(
+			loop.epoll,
+			events,
+			kMaxEvents,
+			NextTimeout(loop));
+		if (count < 0 && errno != EINTR) {
+			std::terminate();
+		}
+		for (auto i = 0; i < count; ++i) {
+			const auto fd = events[i].data.fd;
+			if (fd == loop.wakeup) {
+				ProcessRequests(loop);
+			} else {
+				ProcessWatched(loop, fd, events[i].events);
+			}
+		}
+		ProcessTimers(loop);
+	}
+	loop.quit = false;
+	return loop.code.load();
+}
+
+void quit_main_loop(int code) {
+	auto &loop = Get();
+	loop.code = code;
+	loop.quit = true;
+	Signal(loop);
+}
+
+main_loop_timer add_main_loop_timer(
+		crl::time delay,
+		std::function<void()> callback) {
+	auto &loop = Get();
+	const auto id = ++loop.timerId;
+	const auto when = crl::now() + std::max(delay, crl::time(0));
+	loop.timers.emplace(std::make_pair(when, id), std::move(callback));
+	loop.timerTimes.emplace(id, when);
+	return id;
+}
+
+void cancel_main_loop_timer(main_loop_timer timer) {
+	auto &loop = Get();
+	const auto i = loop.timerTimes.find(timer);
+	if (i != end(loop.timerTimes)) {
+		loop.timers.erase(std::make_pair(i->second, timer));
+		loop.timerTimes.erase(i);
+	}
+}
+
+void watch_main_loop_fd(
+		int fd,
+		std::uint32_t events,
+		std::function<void(std::uint32_t)> callback) {
+	auto &loop = Get();
+	auto event = epoll_event();
+	event.events = events;
+	event.data.fd = fd;
+	const auto operation = loop.watched.count(fd)
+		? EPOLL_CTL_MOD
+		: EPOLL_CTL_ADD;
+	if (epoll_ctl(loop.epoll, operation, fd, &event) < 0) {
+		std::terminate();
+	}
+	loop.watched[fd] = std::move(callback);
+}
+
+void unwatch_main_loop_fd(int fd) {
+	auto &loop = Get();
+	if (loop.watched.erase(fd)) {
+		epoll_ctl(loop.epoll, EPOLL_CTL_DEL, fd, nullptr);
+	}
+}
+
+} // namespace crl
+
+#endif // CRL_USE_LINUX_MAIN_LOOP
@@ -0,0 +1,48 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <crl/common/crl_common_config.h>
+
+#ifdef CRL_USE_LINUX_MAIN_LOOP
+
+#include <crl/crl_time.h>
+#include <cstdint>
+#include <functional>
+
+namespace crl {
+
+// A ready main queue processor for applications without an event loop.
+// The main queue signals an eventfd once per burst of on_main() tasks,
+// run_main_loop() waits for it in epoll together with the timers and
+// the watched file descriptors. Everything except quit_main_loop()
+// should be called from the thread that runs the loop.
+void init_main_loop();
+
+// Returns the code passed to quit_main_loop().
+int run_main_loop();
+void quit_main_loop(int code = 0);
+
+using main_loop_timer = std::uint64_t;
+
+// Calls the callback once after the delay (in milliseconds).
+main_loop_timer add_main_loop_timer(
+	crl::time delay,
+	std::function<void()> callback);
+void cancel_main_loop_timer(main_loop_timer timer);
+
+// Calls the callback with the EPOLL* event mask each time fd is ready.
+void watch_main_loop_fd(
+	int fd,
+	std::uint32_t events,
+	std::function<void(std::uint32_t)> callback);
+void unwatch_main_loop_fd(int fd);
+
+} // namespace crl
+
+#endif // CRL_USE_LINUX_MAIN_LOOP
@@ -0,0 +1,87 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include <crl/common/crl_common_topology.h>
+
+#ifdef CRL_USE_LINUX_TOPOLOGY
+
+#include <fstream>
+#include <string>
+#include <sched.h>
+#include <pthread.h>
+
+namespace crl::details {
+namespace {
+
+// Parses lists like "0-3,8-11".
+std::vector<int> ParseList(const std::string &list) {
+	auto result = std::vector<int>();
+	auto position = std::size_t(0);
+	while (position < list.size()) {
+		auto end = list.find(',', position);
+		if (end == std::string::npos) {
+			end = list.size();
+		}
+		const auto part = list.substr(position, end - position);
+		const auto dash = part.find('-');
+		try {
+			const auto from = std::stoi(part.substr(0, dash));
+			const auto till = (dash == std::string::npos)
+				? from
+				: std::stoi(part.substr(dash + 1));
+			for (auto i = from; i <= till; ++i) {
+				result.push_back(i);
+			}
+		} catch (...) {
+			return {};
+		}
+		position = end + 1;
+	}
+	return result;
+}
+
+std::vector<int> ReadList(const std::string &path) {
+	auto file = std::ifstream(path);
+	auto line = std::string();
+	return std::getline(file, line) ? ParseList(line) : std::vector<int>();
+}
+
+} // namespace
+
+std::vector<std::vector<int>> numa_nodes() {
+	const auto base = std::string("/sys/devices/system/node/");
+	auto result = std::vector<std::vector<int>>();
+	for (const auto node : ReadList(base + "online")) {
+		const auto path = base + "node" + std::to_string(node) + "/cpulist";
+		auto cpus = ReadList(path);
+		if (!cpus.empty()) {
+			result.push_back(std::move(cpus));
+		}
+	}
+	if (result.empty()) {
+		result.emplace_back();
+	}
+	return result;
+}
+
+bool pin_current_thread(const std::vector<int> &cpus) {
+	if (cpus.empty()) {
+		return false;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (const auto cpu : cpus) {
+		if (cpu >= 0 && cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &set);
+		}
+	}
+	return !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+} // namespace crl::details
+
+#endif // CRL_USE_LINUX_TOPOLOGY
@@ -7,6 +7,6 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #include <crl/qt/crl_qt_async.h>
 
-#ifdef CRL_USE_QT
+#if defined CRL_USE_QT && !defined CRL_USE_COMMON_POOL
 
-#endif // CRL_USE_QT
+#endif // CRL_USE_QT && !CRL_USE_COMMON_POOL
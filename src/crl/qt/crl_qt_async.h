@@ -9,7 +9,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include <crl/common/crl_common_config.h>
 
-#ifdef CRL_USE_QT
+#if defined CRL_USE_QT && !defined CRL_USE_COMMON_POOL
 
 #include <crl/common/crl_common_utils.h>
 #include <crl/common/crl_common_sync.h>
@@ -69,4 +69,4 @@ inline void async(Callable &&callable) {
 
 } // namespace crl
 
-#endif // CRL_USE_QT
+#endif // CRL_USE_QT && !CRL_USE_COMMON_POOL
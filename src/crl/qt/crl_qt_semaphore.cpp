@@ -7,6 +7,6 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #include <crl/qt/crl_qt_semaphore.h>
 
-#ifdef CRL_USE_QT
+#if defined CRL_USE_QT && !defined CRL_USE_COMMON_SEMAPHORE
 
-#endif // CRL_USE_QT
+#endif // CRL_USE_QT && !CRL_USE_COMMON_SEMAPHORE
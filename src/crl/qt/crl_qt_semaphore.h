@@ -9,10 +9,13 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include <crl/common/crl_common_config.h>
 
-#ifdef CRL_USE_QT
+#if defined CRL_USE_QT && !defined CRL_USE_COMMON_SEMAPHORE
 
-#include <memory>
+#include <crl/crl_time.h>
 #include <QtCore/QSemaphore>
+#include <algorithm>
+#include <limits>
+#include <memory>
 
 namespace crl {
 
@@ -27,8 +30,18 @@ public:
 	void acquire() {
 		_impl.acquire();
 	}
-	void release() {
-		_impl.release();
+	bool try_acquire() {
+		return _impl.tryAcquire();
+	}
+
+	// Returns false if timeout (in milliseconds) has passed.
+	bool acquire_for(crl::time timeout) {
+		constexpr auto kMax = crl::time(std::numeric_limits<int>::max());
+		return _impl.tryAcquire(1, int(std::clamp(timeout, crl::time(0), kMax)));
+	}
+
+	void release(int count = 1) {
+		_impl.release(count);
 	}
 
 private:
@@ -38,4 +51,4 @@ private:
 
 } // namespace crl
 
-#endif // CRL_USE_QT
+#endif // CRL_USE_QT && !CRL_USE_COMMON_SEMAPHORE
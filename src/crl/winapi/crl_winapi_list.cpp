@@ -19,6 +19,10 @@ PSLIST_HEADER UnwrapList(void *wrapped) {
 	return static_cast<PSLIST_HEADER>(wrapped);
 }
 
+const SLIST_HEADER *UnwrapList(const void *wrapped) {
+	return static_cast<const SLIST_HEADER*>(wrapped);
+}
+
 PSLIST_ENTRY UnwrapEntry(void *wrapped) {
 	return static_cast<PSLIST_ENTRY>(wrapped);
 }
@@ -38,9 +42,7 @@ PSLIST_ENTRY (NTAPI *RtlFirstEntrySList)(const SLIST_HEADER *ListHead) = nullptr
 
 } // namespace
 
-list::list()
-: _impl(std::make_unique<lock_free_list>())
-, _alive(new bool(true)) {
+list::list() {
 	static auto initialize = [] {
 		const auto library = details::dll(
 			L"ntdll.dll",
@@ -52,40 +54,42 @@ list::list()
 	static_assert(alignof(lock_free_list) == MEMORY_ALLOCATION_ALIGNMENT);
 	static_assert(alignof(lock_free_list) >= alignof(SLIST_HEADER));
 	static_assert(sizeof(lock_free_list) == sizeof(SLIST_HEADER));
-	InitializeSListHead(UnwrapList(_impl.get()));
+	InitializeSListHead(UnwrapList(&_impl));
 }
 
 bool list::push_entry(BasicEntry *entry) {
 	return (InterlockedPushEntrySList(
-		UnwrapList(_impl.get()),
+		UnwrapList(&_impl),
 		UnwrapEntry(&entry->plain)) == nullptr);
 }
 
 bool list::empty() const {
-	return RtlFirstEntrySList(UnwrapList(_impl.get())) == nullptr;
+	return RtlFirstEntrySList(UnwrapList(&_impl)) == nullptr;
 }
 
-bool list::process() {
-	if (auto entry = InterlockedFlushSList(UnwrapList(_impl.get()))) {
-		const auto alive = _alive;
+int list::process() {
+	if (auto entry = InterlockedFlushSList(UnwrapList(&_impl))) {
+		auto frame = processing_frame(this);
 		if (const auto next = entry->Next) {
 			entry = ReverseList(entry, next);
 		}
+		auto processed = 0;
 		do {
+			++processed;
 			const auto basic = reinterpret_cast<BasicEntry*>(entry);
 			entry = entry->Next;
 			basic->process(basic);
-			if (!*alive) {
-				delete alive;
-				return false;
+			if (!frame.alive()) {
+				return kDestroyed;
 			}
 		} while (entry);
+		return processed;
 	}
-	return true;
+	return 0;
 }
 
 list::~list() {
-	*_alive = false;
+	processing_frame::destroyed(this);
 }
 
 } // namespace crl::details
@@ -30,7 +30,9 @@ public:
 	bool push_is_first(Callable &&callable) {
 		return push_entry(AllocateEntry(std::forward<Callable>(callable)));
 	}
-	bool process();
+	// Returns the number of processed entries or kDestroyed.
+	static constexpr auto kDestroyed = -1;
+	int process();
 	bool empty() const;
 
 	~list();
@@ -92,8 +94,7 @@ private:
 
 	bool push_entry(BasicEntry *entry);
 
-	const std::unique_ptr<lock_free_list> _impl;
-	bool *_alive = nullptr;
+	lock_free_list _impl;
 
 };
 
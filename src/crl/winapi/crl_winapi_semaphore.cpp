@@ -10,11 +10,12 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #ifdef CRL_USE_WINAPI
 
 #include <crl/winapi/crl_winapi_windows_h.h>
+#include <algorithm>
 
 namespace crl {
 
 auto semaphore::implementation::create() -> pointer {
-	auto result = CreateSemaphore(nullptr, 0, 1, nullptr);
+	auto result = CreateSemaphore(nullptr, 0, LONG_MAX, nullptr);
 	if (!result) {
 		std::terminate();
 	}
@@ -31,8 +32,22 @@ void semaphore::acquire() {
 	WaitForSingleObject(_handle.get(), INFINITE);
 }
 
-void semaphore::release() {
-	ReleaseSemaphore(_handle.get(), 1, nullptr);
+bool semaphore::try_acquire() {
+	return (WaitForSingleObject(_handle.get(), 0) == WAIT_OBJECT_0);
+}
+
+bool semaphore::acquire_for(crl::time timeout) {
+	// Don't let a long timeout become INFINITE.
+	const auto limited = std::clamp(
+		timeout,
+		crl::time(0),
+		crl::time(MAXDWORD - 1));
+	const auto result = WaitForSingleObject(_handle.get(), DWORD(limited));
+	return (result == WAIT_OBJECT_0);
+}
+
+void semaphore::release(int count) {
+	ReleaseSemaphore(_handle.get(), count, nullptr);
 }
 
 } // namespace crl
@@ -5,6 +5,24 @@
 #include <chrono>
 #include <numeric>
 #include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#if defined CRL_USE_LINUX_IO || defined CRL_USE_COMMON_IO
+#include <fcntl.h>
+#include <unistd.h>
+#endif // CRL_USE_LINUX_IO || CRL_USE_COMMON_IO
+
+#ifdef CRL_USE_LINUX_MAIN_LOOP
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // CRL_USE_LINUX_MAIN_LOOP
 
 void testOutput(crl::queue *queue) {
 	for (auto i = 0; i != 1000; ++i) {
@@ -51,6 +69,795 @@ int testCounting(crl::queue (&queues)[kQueueCount]) {
 	return std::accumulate(std::begin(result), std::end(result), 0) + added;
 }
 
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+void testWaitIdle() {
+	constexpr auto kCount = 16;
+	auto queues = std::vector<std::unique_ptr<crl::queue>>();
+	std::atomic<int> processed = 0;
+	for (auto i = 0; i != kCount; ++i) {
+		queues.push_back(std::make_unique<crl::queue>());
+		for (auto j = 0; j != 1000; ++j) {
+			queues.back()->async([&] { ++processed; });
+		}
+	}
+	queues.front()->wait_idle();
+	const auto first = queues.front()->flush(crl::now());
+	crl::wait_all_idle();
+	const auto all = crl::flush_all(crl::now() + 1000);
+	std::cout
+		<< "Should be (1, 1, 16000): "
+		<< first
+		<< ", "
+		<< all
+		<< ", "
+		<< processed
+		<< std::endl;
+}
+
+void testSelfDestroyedQueue() {
+	auto queue = new crl::queue();
+	crl::semaphore done;
+	queue->async([&] {
+		delete queue;
+		done.release();
+	});
+	done.acquire();
+	std::cout
+		<< "Should be 1: "
+		<< crl::flush_all(crl::now() + 1000)
+		<< std::endl;
+}
+
+void testTargetQueue() {
+	constexpr auto kCount = 16;
+	crl::queue parent;
+	crl::queue children[kCount];
+	auto running = 0;
+	auto overlaps = 0;
+	auto processed = 0;
+	for (auto &child : children) {
+		child.set_target(parent);
+	}
+	for (auto i = 0; i != 1000; ++i) {
+		for (auto &child : children) {
+			child.async([&] {
+				// Not atomic, the parent serializes all the children.
+				if (running++) {
+					++overlaps;
+				}
+				++processed;
+				--running;
+			});
+		}
+	}
+	for (auto &child : children) {
+		child.wait_idle();
+	}
+	parent.wait_idle();
+	std::cout
+		<< "Should be (16000, 0): "
+		<< processed
+		<< ", "
+		<< overlaps
+		<< std::endl;
+}
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+
+template <typename Post, typename Wait>
+double measureParallel(Post &&post, Wait &&wait) {
+	const auto start_time = std::chrono::high_resolution_clock::now();
+	for (auto i = 0; i != 1000000; ++i) {
+		post(i);
+	}
+	wait();
+	const auto end_time = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		end_time - start_time).count() / 1000.;
+}
+
+void testConcurrentQueue() {
+	constexpr auto kLimit = 4;
+	crl::concurrent_queue queue(kLimit);
+	std::atomic<int> running = 0;
+	std::atomic<int> maximum = 0;
+	std::atomic<int> processed = 0;
+	for (auto i = 0; i != 10000; ++i) {
+		queue.async([&] {
+			const auto now = ++running;
+			auto was = maximum.load();
+			while (was < now && !maximum.compare_exchange_weak(was, now)) {
+			}
+			++processed;
+			--running;
+		});
+	}
+	queue.wait_idle();
+	std::cout
+		<< "Should be (10000, <= 4): "
+		<< processed
+		<< ", "
+		<< maximum
+		<< std::endl;
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+	// The comparison needs more than one core to show anything.
+	if (std::thread::hardware_concurrency() < 2) {
+		std::cout << "Concurrent queue: skipped on one CPU" << std::endl;
+		return;
+	}
+	crl::queue lanes[kLimit];
+	const auto concurrent = measureParallel([&](int) {
+		queue.async([&] { ++processed; });
+	}, [&] {
+		queue.wait_idle();
+	});
+	const auto stacked = measureParallel([&](int i) {
+		lanes[i % kLimit].async([&] { ++processed; });
+	}, [&] {
+		for (auto &lane : lanes) {
+			lane.wait_idle();
+		}
+	});
+	std::cout
+		<< "Concurrent queue: "
+		<< concurrent
+		<< ", separate queues: "
+		<< stacked
+		<< std::endl;
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+}
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+void testCoalescingQueue() {
+	constexpr auto kKeys = 10;
+	constexpr auto kPosts = 100000;
+	crl::coalescing_queue<int> queue;
+	auto latest = std::vector<int>(kKeys, -1);
+	auto runs = 0;
+	for (auto i = 0; i != kPosts; ++i) {
+		const auto key = i % kKeys;
+		queue.async(key, [&, key, i] {
+			if (latest[key] < i) {
+				latest[key] = i;
+			}
+			++runs;
+		});
+	}
+	queue.wait_idle();
+	auto newest = 0;
+	for (auto key = 0; key != kKeys; ++key) {
+		if (latest[key] == kPosts - kKeys + key) {
+			++newest;
+		}
+	}
+	std::cout
+		<< "Should be (10, 1): "
+		<< newest
+		<< ", "
+		<< (runs < kPosts ? 1 : 0)
+		<< " ("
+		<< runs
+		<< " runs)"
+		<< std::endl;
+
+	// Move-only tasks, the replaced ones are destroyed without a call.
+	struct Counted {
+		explicit Counted(int value, int *destroyed)
+		: value(value)
+		, destroyed(destroyed) {
+		}
+		~Counted() {
+			++*destroyed;
+		}
+		int value = 0;
+		int *destroyed = nullptr;
+	};
+	auto destroyed = 0;
+	auto last = -1;
+	for (auto i = 0; i != 3; ++i) {
+		auto counted = std::make_unique<Counted>(i, &destroyed);
+		queue.async(kKeys, [&, counted = std::move(counted)] {
+			last = counted->value;
+		});
+	}
+	queue.wait_idle();
+	std::cout
+		<< "Should be (3, 2): "
+		<< destroyed
+		<< ", "
+		<< last
+		<< std::endl;
+}
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+
+void testKeyedExecutor() {
+	constexpr auto kKeys = 1000;
+	constexpr auto kTasks = 100;
+	crl::keyed_executor<int> executor;
+	auto last = std::vector<int>(kKeys, -1);
+	auto ordered = std::vector<char>(kKeys, 1);
+	for (auto i = 0; i != kTasks; ++i) {
+		for (auto key = 0; key != kKeys; ++key) {
+			executor.async(key, [&, key, i] {
+				if (last[key] != i - 1) {
+					ordered[key] = 0;
+				}
+				last[key] = i;
+			});
+		}
+	}
+	executor.wait_idle();
+	std::cout
+		<< "Should be (1000, 0): "
+		<< std::count(begin(ordered), end(ordered), 1)
+		<< ", "
+		<< executor.lanes()
+		<< std::endl;
+}
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+void testGroup() {
+	crl::group group;
+	crl::queue queue;
+	crl::semaphore notified;
+	std::atomic<int> decoded = 0;
+	auto seen = 0;
+	for (auto i = 0; i != 1000; ++i) {
+		crl::async(group, [&] { ++decoded; });
+	}
+	group.notify(queue, [&] {
+		seen = decoded;
+		notified.release();
+	});
+	notified.acquire();
+	for (auto i = 0; i != 1000; ++i) {
+		crl::async(group, queue, [&] { ++decoded; });
+	}
+	group.wait();
+	queue.wait_idle();
+	std::cout
+		<< "Should be (1000, 2000): "
+		<< seen
+		<< ", "
+		<< decoded
+		<< std::endl;
+}
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+void testRateLimits() {
+	crl::queue queue;
+	auto debounced_runs = 0;
+	auto throttled_runs = 0;
+	{
+		const auto debounced = crl::debounced(queue, 50, [&] {
+			++debounced_runs;
+		});
+		const auto throttled = crl::throttled(queue, 20, [&] {
+			++throttled_runs;
+		});
+		const auto till = crl::now() + 200;
+		while (crl::now() < till) {
+			for (auto i = 0; i != 1000; ++i) {
+				debounced();
+				throttled();
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	queue.wait_idle();
+	std::cout
+		<< "Should be (1, <= 12): "
+		<< debounced_runs
+		<< ", "
+		<< throttled_runs
+		<< std::endl;
+}
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+
+void testSyncPrimitives() {
+	constexpr auto kThreads = 4;
+	constexpr auto kPhases = 3;
+	crl::latch finished(kThreads);
+	crl::barrier barrier(kThreads);
+	crl::event manual(true);
+	crl::event automatic;
+	std::atomic<int> arrived[kPhases] = {};
+	std::atomic<int> mismatches = 0;
+	std::atomic<int> woken = 0;
+
+	// The barrier needs all the threads at once, don't use the pool.
+	std::vector<std::thread> threads;
+	for (auto i = 0; i != kThreads; ++i) {
+		threads.emplace_back([&] {
+			manual.wait();
+			for (auto phase = 0; phase != kPhases; ++phase) {
+				++arrived[phase];
+				barrier.arrive_and_wait();
+				if (arrived[phase] != kThreads) {
+					++mismatches;
+				}
+			}
+			if (automatic.wait_until(crl::now() + 1000)) {
+				++woken;
+			}
+			finished.count_down();
+		});
+	}
+	const auto timedOut = !finished.wait_until(crl::now() + 50);
+	manual.set();
+	for (auto i = 0; i != kThreads; ++i) {
+		automatic.set();
+		while (automatic.is_set()) {
+			std::this_thread::yield();
+		}
+	}
+	finished.wait();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	std::cout
+		<< "Should be (1, 0, 4, 0): "
+		<< timedOut
+		<< ", "
+		<< mismatches
+		<< ", "
+		<< woken
+		<< ", "
+		<< automatic.try_wait()
+		<< std::endl;
+}
+
+void testSemaphore() {
+	constexpr auto kWaiters = 4;
+	crl::semaphore semaphore;
+	const auto timedOut = !semaphore.acquire_for(20);
+	semaphore.release(3);
+	auto acquired = 0;
+	while (semaphore.try_acquire()) {
+		++acquired;
+	}
+	std::atomic<int> woken = 0;
+	std::vector<std::thread> threads;
+	for (auto i = 0; i != kWaiters; ++i) {
+		threads.emplace_back([&] {
+			semaphore.acquire();
+			++woken;
+		});
+	}
+	semaphore.release(kWaiters);
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	std::cout
+		<< "Should be (1, 3, 4): "
+		<< timedOut
+		<< ", "
+		<< acquired
+		<< ", "
+		<< woken
+		<< std::endl;
+}
+
+#ifdef CRL_USE_COMMON_POOL
+std::atomic<int> Deadlocks = 0;
+
+void testHelpWhileWaiting() {
+	// With a single worker nested sync calls would hang without helping.
+	auto settings = crl::pool_settings();
+	settings.max_threads = 1;
+	settings.deadlock_timeout = 100;
+	crl::configure_pool(settings);
+	crl::set_pool_deadlock_handler([](const crl::pool_stats &) {
+		++Deadlocks;
+	});
+
+	constexpr auto kDepth = 8;
+	auto depth = 0;
+	std::function<void()> nested = [&] {
+		if (++depth < kDepth) {
+			crl::sync(nested);
+		}
+	};
+	crl::semaphore done;
+	crl::async([&] {
+		nested();
+		done.release();
+	});
+	done.acquire();
+
+	// The only worker waits for a blocking queue that waits for us.
+	crl::semaphore gate;
+	crl::queue blocked(crl::blocking);
+	blocked.async([&] { gate.acquire(); });
+	crl::async([&] {
+		blocked.sync([] {});
+		done.release();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	const auto reported = Deadlocks.load();
+	gate.release();
+	done.acquire();
+	blocked.wait_idle();
+
+	// A worker inside a serial queue doesn't help, the first task it
+	// would take syncs into that queue and would wait for it forever.
+	crl::queue serial;
+	auto reentered = 0;
+	serial.async([&] {
+		crl::async([&] {
+			serial.sync([&] { ++reentered; });
+			done.release();
+		});
+		crl::sync([] {});
+	});
+	done.acquire();
+	serial.wait_idle();
+
+	crl::set_pool_deadlock_handler(nullptr);
+	crl::configure_pool(crl::pool_settings());
+	std::cout
+		<< "Should be (8, 1, 1): "
+		<< depth
+		<< ", "
+		<< reported
+		<< ", "
+		<< reentered
+		<< std::endl;
+}
+#endif // CRL_USE_COMMON_POOL
+
+void testScope() {
+#ifdef CRL_USE_COMMON_POOL
+	// Nested joins on a single worker help instead of hanging.
+	auto settings = crl::pool_settings();
+	settings.max_threads = 1;
+	crl::configure_pool(settings);
+#endif // CRL_USE_COMMON_POOL
+
+	std::atomic<int> finished = 0;
+	{
+		crl::scope outer;
+		for (auto i = 0; i != 4; ++i) {
+			outer.async([&] {
+				crl::scope inner(outer);
+				for (auto j = 0; j != 100; ++j) {
+					inner.async([&] { ++finished; });
+				}
+			});
+		}
+	}
+#ifdef CRL_USE_COMMON_POOL
+	crl::configure_pool(crl::pool_settings());
+#endif // CRL_USE_COMMON_POOL
+
+	std::atomic<int> skipped = 0;
+	auto cancelled = false;
+	{
+		crl::semaphore gate;
+		crl::queue queue;
+		crl::scope parent;
+		crl::scope child(parent);
+		child.async(queue, [&] { gate.acquire(); });
+		for (auto i = 0; i != 100; ++i) {
+			child.async(queue, [&] { ++skipped; });
+		}
+		parent.cancel();
+		cancelled = child.cancelled();
+		gate.release();
+		child.join();
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+		queue.wait_idle();
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+	}
+	std::cout
+		<< "Should be (400, 0, 1): "
+		<< finished
+		<< ", "
+		<< skipped
+		<< ", "
+		<< (cancelled ? 1 : 0)
+		<< std::endl;
+}
+
+#ifdef CRL_USE_COMMON_POOL
+void testBlockingPool() {
+	constexpr auto kTasks = 8;
+	crl::latch started(kTasks);
+	crl::latch finished(kTasks + 1);
+	crl::event release(true);
+	for (auto i = 0; i != kTasks; ++i) {
+		crl::async_blocking([&] {
+			started.count_down();
+			release.wait();
+			finished.count_down();
+		});
+	}
+
+	// All of them are parked at once, even with a single CPU worker.
+	started.wait();
+	const auto blocked = crl::blocking_pool_statistics().busy;
+	auto computed = 0;
+	crl::queue queue;
+	queue.async([&] { computed = 1; });
+	queue.wait_idle();
+
+	crl::queue files(crl::blocking);
+	files.async([&] { finished.count_down(); });
+	release.set();
+	finished.wait();
+	files.wait_idle();
+	std::cout
+		<< "Should be (8, 1): "
+		<< blocked
+		<< ", "
+		<< computed
+		<< std::endl;
+}
+#endif // CRL_USE_COMMON_POOL
+
+#if (defined CRL_USE_LINUX_IO || defined CRL_USE_COMMON_IO) \
+	&& (defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH)
+void testFileIO() {
+	constexpr auto kBlocks = 2000;
+	constexpr auto kBlockSize = 4096;
+	const auto path = (std::filesystem::temp_directory_path()
+		/ "crl_io_test.tmp").string();
+	crl::queue queue;
+	auto fd = -1;
+	auto written = 0;
+	auto matched = 0;
+	auto synced = -1;
+
+	auto opened = crl::latch(1);
+	crl::io::openat(
+		AT_FDCWD,
+		path,
+		O_RDWR | O_CREAT | O_TRUNC,
+		0600,
+		queue,
+		[&](int result) { fd = result; opened.count_down(); });
+	opened.wait();
+
+	auto data = std::vector<char>(kBlocks * kBlockSize);
+	for (auto i = 0; i != kBlocks; ++i) {
+		std::fill_n(data.data() + i * kBlockSize, kBlockSize, char(i));
+	}
+	auto writes = crl::latch(kBlocks);
+	for (auto i = 0; i != kBlocks; ++i) {
+		const auto offset = i * kBlockSize;
+		crl::io::write(fd, offset, data.data() + offset, kBlockSize, queue, [&](int result) {
+			written += (result == kBlockSize) ? 1 : 0;
+			writes.count_down();
+		});
+	}
+	writes.wait();
+
+	auto flushed = crl::latch(1);
+	crl::io::fsync(fd, queue, [&](int result) {
+		synced = result;
+		flushed.count_down();
+	});
+	flushed.wait();
+
+	// All the reads are in flight at once, no thread waits for them.
+	auto read = std::vector<char>(kBlocks * kBlockSize);
+	auto reads = crl::latch(kBlocks);
+	for (auto i = 0; i != kBlocks; ++i) {
+		const auto offset = i * kBlockSize;
+		crl::io::read(fd, offset, read.data() + offset, kBlockSize, queue, [&, i](int result) {
+			const auto begin = read.data() + i * kBlockSize;
+			const auto good = (result == kBlockSize)
+				&& std::all_of(begin, begin + kBlockSize, [&](char ch) {
+					return ch == char(i);
+				});
+			matched += good ? 1 : 0;
+			reads.count_down();
+		});
+	}
+	reads.wait();
+	queue.wait_idle();
+	close(fd);
+	std::remove(path.c_str());
+	std::cout
+		<< "Should be (2000, 0, 2000): "
+		<< written
+		<< ", "
+		<< synced
+		<< ", "
+		<< matched
+		<< std::endl;
+}
+#endif // (CRL_USE_LINUX_IO || CRL_USE_COMMON_IO) && common queue
+
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+void testManyQueues() {
+	constexpr auto kCount = 1000000;
+	auto start_time = std::chrono::high_resolution_clock::now();
+	for (auto i = 0; i != 5 * kCount; ++i) {
+		const auto queue = std::make_unique<crl::queue>();
+	}
+	auto end_time = std::chrono::high_resolution_clock::now();
+	const auto empty = std::chrono::duration_cast<std::chrono::milliseconds>(
+		end_time - start_time).count() / 1000.;
+
+	std::atomic<int> processed = 0;
+	start_time = std::chrono::high_resolution_clock::now();
+	{
+		auto queues = std::vector<crl::queue>(kCount);
+		for (auto &queue : queues) {
+			queue.async([&] { ++processed; });
+		}
+		crl::wait_all_idle();
+	}
+	end_time = std::chrono::high_resolution_clock::now();
+	const auto used = std::chrono::duration_cast<std::chrono::milliseconds>(
+		end_time - start_time).count() / 1000.;
+	std::cout
+		<< "Queue size: "
+		<< sizeof(crl::queue)
+		<< ", 5M empty queues: "
+		<< empty
+		<< ", 1M used queues: "
+		<< used
+		<< " ("
+		<< processed
+		<< ")"
+		<< std::endl;
+}
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+
+struct Counter {
+	int value = 0;
+};
+
+void testStrands() {
+	constexpr auto kObjects = 100000;
+	constexpr auto kCalls = 10;
+	std::atomic<int> matched = 0;
+	auto start_time = std::chrono::high_resolution_clock::now();
+	{
+		crl::latch done(kObjects);
+		auto objects = std::vector<std::unique_ptr<
+			crl::object_on_queue<Counter>>>();
+		objects.reserve(kObjects);
+		for (auto i = 0; i != kObjects; ++i) {
+			objects.push_back(
+				std::make_unique<crl::object_on_queue<Counter>>());
+		}
+		for (auto i = 0; i != kCalls; ++i) {
+			for (const auto &object : objects) {
+				object->with([](Counter &counter) { ++counter.value; });
+			}
+		}
+		for (const auto &object : objects) {
+			object->with([&](Counter &counter) {
+				if (counter.value == kCalls) {
+					++matched;
+				}
+				done.count_down();
+			});
+		}
+		done.wait();
+	}
+	auto end_time = std::chrono::high_resolution_clock::now();
+	const auto strands = std::chrono::duration_cast<std::chrono::milliseconds>(
+		end_time - start_time).count() / 1000.;
+
+	auto queues = 0.;
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+	start_time = std::chrono::high_resolution_clock::now();
+	{
+		auto queues = std::vector<crl::queue>(kObjects);
+		auto counters = std::vector<Counter>(kObjects);
+		for (auto i = 0; i != kCalls; ++i) {
+			for (auto j = 0; j != kObjects; ++j) {
+				queues[j].async([&, j] { ++counters[j].value; });
+			}
+		}
+		crl::wait_all_idle();
+	}
+	end_time = std::chrono::high_resolution_clock::now();
+	queues = std::chrono::duration_cast<std::chrono::milliseconds>(
+		end_time - start_time).count() / 1000.;
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+	std::cout
+		<< "Should be 100000: "
+		<< matched
+		<< ", objects on strands: "
+		<< strands
+		<< ", separate queues: "
+		<< queues
+		<< std::endl;
+
+	// Each object syncs into the next one from its own task.
+	constexpr auto kChain = 64;
+	auto chain = std::vector<std::unique_ptr<
+		crl::object_on_queue<Counter>>>();
+	for (auto i = 0; i != kChain; ++i) {
+		chain.push_back(std::make_unique<crl::object_on_queue<Counter>>());
+	}
+	crl::latch nested(kChain - 1);
+	for (auto i = 0; i + 1 != kChain; ++i) {
+		chain[i]->with([&, i](Counter &counter) {
+			chain[i + 1]->with_sync([](Counter &next) { ++next.value; });
+			++counter.value;
+			nested.count_down();
+		});
+	}
+	nested.wait();
+	auto total = 0;
+	for (const auto &object : chain) {
+		total += object->with_sync([](const Counter &counter) {
+			return counter.value;
+		});
+	}
+	std::cout << "Should be 126: " << total << std::endl;
+}
+
+struct Summer {
+	void handle(crl::span<int> messages) {
+		for (const auto value : messages) {
+			sum += value;
+		}
+		++batches;
+	}
+
+	long long sum = 0;
+	int batches = 0;
+};
+
+void testActor() {
+	constexpr auto kMessages = 1000000;
+	auto start_time = std::chrono::high_resolution_clock::now();
+	auto sum = 0LL;
+	auto batches = 0;
+	{
+		// The pending tasks keep the state alive after the actor dies.
+		crl::latch done(1);
+		crl::actor<Summer, int> actor;
+		for (auto i = 0; i != kMessages; ++i) {
+			actor.send(i);
+		}
+		actor.with([&](Summer &summer) {
+			sum = summer.sum;
+			batches = summer.batches;
+			done.count_down();
+		});
+		done.wait();
+	}
+	auto end_time = std::chrono::high_resolution_clock::now();
+	const auto mailbox = std::chrono::duration_cast<std::chrono::milliseconds>(
+		end_time - start_time).count() / 1000.;
+
+	start_time = std::chrono::high_resolution_clock::now();
+	{
+		crl::latch done(1);
+		crl::object_on_queue<Summer> object;
+		for (auto i = 0; i != kMessages; ++i) {
+			object.with([=](Summer &summer) { summer.sum += i; });
+		}
+		object.with([&](Summer &) { done.count_down(); });
+		done.wait();
+	}
+	end_time = std::chrono::high_resolution_clock::now();
+	const auto closures = std::chrono::duration_cast<std::chrono::milliseconds>(
+		end_time - start_time).count() / 1000.;
+	std::cout
+		<< "Should be (499999500000, 1): "
+		<< sum
+		<< ", "
+		<< (batches < kMessages ? 1 : 0)
+		<< " ("
+		<< batches
+		<< " batches), actor: "
+		<< mailbox
+		<< ", object on queue: "
+		<< closures
+		<< std::endl;
+}
+
 struct MainRequest {
 	void (*callable)(void*);
 	void *argument;
@@ -65,6 +872,35 @@ void DrainMainRequests() {
 	}
 }
 
+void testGuardedMainQueue() {
+	struct Object : crl::has_weak_guard {
+	};
+	auto alive = 0;
+	auto dead = 0;
+	auto destroyed = std::make_shared<int>(0);
+	auto live = std::make_unique<Object>();
+	auto dying = std::make_unique<Object>();
+	for (auto i = 0; i != 1000; ++i) {
+		crl::on_main(live.get(), [&] { ++alive; });
+		crl::on_main(dying.get(), [&, counter = std::shared_ptr<int>(
+			nullptr,
+			[=](int*) { ++*destroyed; })] { ++dead; });
+	}
+	dying = nullptr;
+	const auto purged = *destroyed;
+	crl::on_main(live.get(), [&] { live = nullptr; });
+	crl::on_main(live.get(), [&] { ++alive; });
+	DrainMainRequests();
+	std::cout
+		<< "Should be (1000, 1000, 0): "
+		<< alive
+		<< ", "
+		<< purged
+		<< ", "
+		<< dead
+		<< std::endl;
+}
+
 void testMainQueue() {
 	auto count = 0;
 	auto add = [&] {
@@ -90,9 +926,287 @@ void testMainQueue() {
 	DrainMainRequests();
 	auto c = count;
 	std::cout << "Should be (0, 0, 120): " << a << ", " << b << ", " << c << std::endl;
+
+	testGuardedMainQueue();
+}
+
+#ifdef CRL_USE_LINUX_MAIN_LOOP
+// The main queue can be initialized only once, so the loop runs in a
+// child process, forked before any pool thread is started.
+void testMainLoop() {
+	std::cout.flush();
+	if (const auto child = fork()) {
+		waitpid(child, nullptr, 0);
+		return;
+	}
+	crl::init_main_loop();
+
+	int fds[2] = { -1, -1 };
+	if (pipe(fds) < 0) {
+		_exit(1);
+	}
+	auto posted = 0;
+	auto fired = 0;
+	auto cancelled = 0;
+	auto reads = 0;
+	crl::watch_main_loop_fd(fds[0], EPOLLIN, [&](std::uint32_t events) {
+		auto buffer = char();
+		if ((events & EPOLLIN) && read(fds[0], &buffer, 1) == 1) {
+			++reads;
+		}
+		crl::unwatch_main_loop_fd(fds[0]);
+		crl::quit_main_loop(7);
+	});
+	crl::cancel_main_loop_timer(crl::add_main_loop_timer(10, [&] {
+		++cancelled;
+	}));
+	auto poster = std::thread();
+	crl::add_main_loop_timer(20, [&] {
+		++fired;
+		poster = std::thread([&] {
+			crl::on_main([&] {
+				++posted;
+				const auto written = write(fds[1], "x", 1);
+				(void)written;
+			});
+		});
+	});
+	crl::add_main_loop_timer(5000, [] { crl::quit_main_loop(-1); });
+	const auto code = crl::run_main_loop();
+	poster.join();
+	std::cout
+		<< "Should be (1, 1, 0, 1, 7): "
+		<< posted
+		<< ", "
+		<< fired
+		<< ", "
+		<< cancelled
+		<< ", "
+		<< reads
+		<< ", "
+		<< code
+		<< std::endl;
+	std::cout.flush();
+	_exit(0);
+}
+#endif // CRL_USE_LINUX_MAIN_LOOP
+
+void testObjectOnQueue() {
+	struct Counter {
+		int value = 0;
+	};
+	auto sum = 0;
+	{
+		crl::object_on_queue<Counter> counter;
+		for (auto i = 0; i != 100000; ++i) {
+			counter.with([](Counter &that) { ++that.value; });
+		}
+		crl::semaphore waiter;
+		counter.with([&](const Counter &that) {
+			sum = that.value;
+			waiter.release();
+		});
+		waiter.acquire();
+	}
+	std::cout << "Should be 100000: " << sum << std::endl;
+}
+
+void testWeakObjectOnQueue() {
+	struct Counter {
+		explicit Counter(crl::semaphore *destroyed) : destroyed(destroyed) {
+		}
+		~Counter() {
+			destroyed->release();
+		}
+		int value = 0;
+		crl::semaphore *destroyed = nullptr;
+	};
+	auto sum = 0;
+	auto late = 0;
+	crl::semaphore destroyed;
+	auto weak = crl::weak_on_queue<Counter>();
+	{
+		crl::object_on_queue<Counter> counter(&destroyed);
+		weak = counter.weak();
+		for (auto i = 0; i != 100000; ++i) {
+			if (i % 2) {
+				counter.with([](Counter &that) { ++that.value; });
+			} else {
+				weak.with([](Counter &that) { ++that.value; });
+			}
+		}
+		crl::semaphore waiter;
+		weak.with([&](const Counter &that) {
+			sum = that.value;
+			waiter.release();
+		});
+		waiter.acquire();
+	}
+
+	// The references taken by the weak calls don't outlive the calls.
+	const auto released = destroyed.acquire_for(1000);
+	weak.with([&](Counter &) { ++late; });
+	std::cout
+		<< "Should be (100000, 1, 0): "
+		<< sum
+		<< ", "
+		<< released
+		<< ", "
+		<< late
+		<< std::endl;
+}
+
+void testObjectOnQueueSync() {
+	struct Counter {
+		int value = 0;
+	};
+	auto sum = 0;
+	{
+		crl::object_on_queue<Counter> counter;
+		for (auto i = 0; i != 100000; ++i) {
+			counter.with([](Counter &that) { ++that.value; });
+		}
+		sum = counter.with_sync([](const Counter &that) {
+			return that.value;
+		});
+		counter.with_sync([](Counter &that) { ++that.value; });
+		sum += counter.with_value([](const Counter &that) {
+			return that.value;
+		}).get();
+	}
+	std::cout << "Should be 200001: " << sum << std::endl;
+}
+
+void testSharedObjectOnQueue() {
+	struct Counter {
+		int value = 0;
+	};
+	std::atomic<int> reads = 0;
+	std::atomic<int> mismatches = 0;
+	{
+		crl::shared_object_on_queue<Counter> counter;
+		const auto &readonly = counter;
+		for (auto i = 0; i != 10000; ++i) {
+			if (i % 10) {
+				readonly.with([&, i](const Counter &that) {
+					if (that.value != (i / 10) + 1) {
+						++mismatches;
+					}
+					++reads;
+				});
+			} else {
+				counter.with([](Counter &that) { ++that.value; });
+			}
+		}
+		crl::semaphore waiter;
+		counter.with([&](Counter &) { waiter.release(); });
+		waiter.acquire();
+	}
+
+	struct Pinger {
+		Pinger(crl::weak_shared_on_queue<Pinger> weak) : weak(weak) {
+		}
+		crl::weak_shared_on_queue<Pinger> weak;
+	};
+	auto pinged = 0;
+	{
+		crl::shared_object_on_queue<Pinger> pinger;
+		crl::semaphore waiter;
+		pinger.with([&](Pinger &that) {
+			that.weak.with([&](Pinger &) {
+				pinged = 1;
+				waiter.release();
+			});
+		});
+		waiter.acquire();
+	}
+	std::cout
+		<< "Should be (9000, 0, 1): "
+		<< reads
+		<< ", "
+		<< mismatches
+		<< ", "
+		<< pinged
+		<< std::endl;
+
+	// A shared task from a weak handle holds the last reference.
+	struct Watched {
+		explicit Watched(crl::semaphore *destroyed) : destroyed(destroyed) {
+		}
+		~Watched() {
+			destroyed->release();
+		}
+		crl::semaphore *destroyed = nullptr;
+	};
+	crl::semaphore entered;
+	crl::semaphore released;
+	crl::semaphore destroyed;
+	{
+		auto watched = std::make_unique<
+			crl::shared_object_on_queue<Watched>>(&destroyed);
+		const auto weak = std::as_const(*watched).weak();
+		watched->with([&, weak](Watched &) {
+			entered.release();
+			released.acquire();
+
+			// Queued after the destroying task of the object.
+			weak.with([](const Watched &) {});
+		});
+		entered.acquire();
+		watched = nullptr;
+		released.release();
+	}
+	std::cout
+		<< "Should be 1: "
+		<< destroyed.acquire_for(1000)
+		<< std::endl;
+}
+
+template <typename Guard>
+double measureGuard(const Guard &guard) {
+	constexpr auto kThreads = 4;
+	constexpr auto kChecks = 1000000;
+	std::atomic<int> checked = 0;
+	crl::semaphore waiter;
+	auto start_time = std::chrono::high_resolution_clock::now();
+	for (auto i = 0; i != kThreads; ++i) {
+		crl::async([&] {
+			// Volatile, so that each check is really made in the loop.
+			volatile auto local = 0;
+			auto wrap = crl::guard(Guard(guard), [&] { local = local + 1; });
+			for (auto j = 0; j != kChecks; ++j) {
+				wrap();
+			}
+			checked += local;
+			waiter.release();
+		});
+	}
+	for (auto i = 0; i != kThreads; ++i) {
+		waiter.acquire();
+	}
+	auto end_time = std::chrono::high_resolution_clock::now();
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+
+	// Per check, the whole run is too short for milliseconds.
+	return (checked == kThreads * kChecks)
+		? (double(ns.count()) / (kThreads * kChecks))
+		: -1.;
+}
+
+void testGuards() {
+	struct Object : crl::has_weak_guard {
+	};
+	const auto shared = std::make_shared<Object>();
+	const auto weak = std::weak_ptr<Object>(shared);
+	const auto guard = crl::weak_guard(shared.get());
+	std::cout << "Time weak_ptr guard: " << measureGuard(weak) << "ns" << std::endl;
+	std::cout << "Time weak_guard: " << measureGuard(guard) << "ns" << std::endl;
 }
 
 int main() {
+#ifdef CRL_USE_LINUX_MAIN_LOOP
+	testMainLoop();
+#endif // CRL_USE_LINUX_MAIN_LOOP
 	crl::queue testQueue[kQueueCount];
 //	testOutput(&testQueue[0]);
 	for (int i = 0; i != 5; ++i) {
@@ -102,7 +1216,53 @@ int main() {
 		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 		std::cout << "Time: " << ms.count() / 1000. << " (" << result << ")" << std::endl;
 	}
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+	testWaitIdle();
+	testSelfDestroyedQueue();
+	testTargetQueue();
+	testManyQueues();
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+	testConcurrentQueue();
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+	testGroup();
+	testCoalescingQueue();
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+	testKeyedExecutor();
+#if defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH
+	testRateLimits();
+#endif // CRL_USE_COMMON_QUEUE || !CRL_USE_DISPATCH
+	testSyncPrimitives();
+	testSemaphore();
+#ifdef CRL_USE_COMMON_POOL
+	testBlockingPool();
+	testHelpWhileWaiting();
+#endif // CRL_USE_COMMON_POOL
+	testScope();
+#if (defined CRL_USE_LINUX_IO || defined CRL_USE_COMMON_IO) \
+	&& (defined CRL_USE_COMMON_QUEUE || !defined CRL_USE_DISPATCH)
+	testFileIO();
+#endif // (CRL_USE_LINUX_IO || CRL_USE_COMMON_IO) && common queue
+#ifdef CRL_USE_COMMON_POOL
+	const auto stats = crl::pool_statistics();
+	std::cout
+		<< "Pool threads: "
+		<< stats.threads
+		<< " of "
+		<< stats.max_threads
+		<< ", utilisation: "
+		<< stats.utilisation
+		<< ", nodes: "
+		<< crl::pool_nodes()
+		<< std::endl;
+#endif // CRL_USE_COMMON_POOL
 	testMainQueue();
+	testObjectOnQueue();
+	testWeakObjectOnQueue();
+	testObjectOnQueueSync();
+	testSharedObjectOnQueue();
+	testStrands();
+	testActor();
+	testGuards();
 	std::cout << "Finished." << std::endl;
 	int a = 0;
 	std::cin >> a;